@@ -14,6 +14,10 @@ static Runtime Runtime = {
         .InActiveTiledWindowBorderColour = 0xff0000,
         .ActiveFloatingWindowBorderColour = 0x0000ff,
         .InActiveFloatingWindowBorderColour = 0xff0000,
+        .AnimationFrames = 0,
+        .DefaultLayout = "Tree",
+        .TraceEvents = 0,
+        .BackgroundThrottle = "None",
     }, //*/
 
     /*
@@ -26,6 +30,15 @@ static Runtime Runtime = {
         .InActiveTiledWindowBorderColour = 0xff0000,
         .ActiveFloatingWindowBorderColour = 0x0000ff,
         .InActiveFloatingWindowBorderColour = 0xff0000,
+        .AnimationFrames = 4,
+        .DefaultLayout = "Balanced",
+        .TraceEvents = 65536,
+        .BackgroundThrottle = "CGroup",
+        .ThrottleCGroup = "/sys/fs/cgroup/user.slice/user-1000.slice/user@1000.service/exert-background",
+        .ThrottleCpuMax = "10000 100000",
+        .ThrottleExempt = {"spotify", "mpv", "Pavucontrol"},
+        .WarmPool = {{"alacritty", 2}},
+        .StateSnapshot = "/exert-state",
     }, */
     
     // * KEYBINDS
@@ -42,10 +55,30 @@ static Runtime Runtime = {
         {XK_Right, {XCB_MOD_MASK_1, "exert-command MoveFloatingWindow Right"}},
         {XK_Up, {XCB_MOD_MASK_1, "exert-command MoveFloatingWindow Up"}},
         {XK_Down, {XCB_MOD_MASK_1, "exert-command MoveFloatingWindow Down"}},
+        {XK_Left, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command FocusDirection Left"}},
+        {XK_Right, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command FocusDirection Right"}},
+        {XK_Up, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command FocusDirection Up"}},
+        {XK_Down, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command FocusDirection Down"}},
+        {XK_Left, {XCB_MOD_MASK_4 | XCB_MOD_MASK_CONTROL, "exert-command SwapDirection Left"}},
+        {XK_Right, {XCB_MOD_MASK_4 | XCB_MOD_MASK_CONTROL, "exert-command SwapDirection Right"}},
+        {XK_Up, {XCB_MOD_MASK_4 | XCB_MOD_MASK_CONTROL, "exert-command SwapDirection Up"}},
+        {XK_Down, {XCB_MOD_MASK_4 | XCB_MOD_MASK_CONTROL, "exert-command SwapDirection Down"}},
+        {XK_Left, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL, "exert-command MoveDirection Left"}},
+        {XK_Right, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL, "exert-command MoveDirection Right"}},
+        {XK_Up, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL, "exert-command MoveDirection Up"}},
+        {XK_Down, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL, "exert-command MoveDirection Down"}},
         {XK_x, {XCB_MOD_MASK_4, "exert-command MoveActiveWindow"}},
         {XK_l, {XCB_MOD_MASK_4, "exert-command ChangeActiveWindowSplitDirection"}},
         {XK_k, {XCB_MOD_MASK_4, "exert-command SwapActiveWindowSides"}},
         {XK_v, {XCB_MOD_MASK_4, "exert-command ToggleActiveWindowFloating"}},
+        {XK_t, {XCB_MOD_MASK_4, "exert-command SetLayout Tree"}},
+        {XK_b, {XCB_MOD_MASK_4, "exert-command SetLayout Balanced"}},
+        {XK_g, {XCB_MOD_MASK_4, "exert-command SetLayout Grid"}},
+        {XK_n, {XCB_MOD_MASK_4, "exert-command SetLayout MasterStack"}},
+        {XK_s, {XCB_MOD_MASK_4, "exert-command ToggleTabbed"}},
+        {XK_Tab, {XCB_MOD_MASK_4, "exert-command CycleTab Next"}},
+        {XK_Tab, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command CycleTab Previous"}},
+        {XK_F12, {XCB_MOD_MASK_4, "exert-command DumpTrace /tmp/exert-trace.json"}},
 
         // Programs
         {XK_space, {XCB_MOD_MASK_4, "rofi -show drun"}},
@@ -70,6 +103,17 @@ static Runtime Runtime = {
         {XK_7, {XCB_MOD_MASK_4, "exert-command SetFocusedMonitorToWorkspace 6"}},
         {XK_8, {XCB_MOD_MASK_4, "exert-command SetFocusedMonitorToWorkspace 7"}},
         {XK_9, {XCB_MOD_MASK_4, "exert-command SetFocusedMonitorToWorkspace 8"}},
+        {XK_1, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command MoveActiveWindowToWorkspace 0"}},
+        {XK_2, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command MoveActiveWindowToWorkspace 1"}},
+        {XK_3, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command MoveActiveWindowToWorkspace 2"}},
+        {XK_4, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command MoveActiveWindowToWorkspace 3"}},
+        {XK_5, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command MoveActiveWindowToWorkspace 4"}},
+        {XK_6, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command MoveActiveWindowToWorkspace 5"}},
+        {XK_7, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command MoveActiveWindowToWorkspace 6"}},
+        {XK_8, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command MoveActiveWindowToWorkspace 7"}},
+        {XK_9, {XCB_MOD_MASK_4 | XCB_MOD_MASK_SHIFT, "exert-command MoveActiveWindowToWorkspace 8"}},
+        {XK_Left, {XCB_MOD_MASK_4 | XCB_MOD_MASK_1, "exert-command MoveActiveWindowToMonitor Left"}},
+        {XK_Right, {XCB_MOD_MASK_4 | XCB_MOD_MASK_1, "exert-command MoveActiveWindowToMonitor Right"}},
     },
 
     // * MOUSEBINDS
@@ -98,5 +142,12 @@ static Runtime Runtime = {
         "picom -b --experimental-backends",
         "/home/pika/Config/scripts/wallpaper/change-wallpaper.sh",
         "xset -dpms && xset s off",
+    },
+
+    // * WINDOW RULES
+    {
+        {.Class = "firefox", .Workspace = 1},
+        {.Class = "Pavucontrol", .Floating = 1, .Width = 0.4, .Height = 0.5},
+        {.WindowType = "_NET_WM_WINDOW_TYPE_DIALOG", .Floating = 1},
     }
 };
@@ -1,16 +1,40 @@
 #include <cassert>
+#include <cerrno>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <functional>
 #include <iostream>
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <memory>
 #include <ostream>
+#include <queue>
+#include <random>
+#include <sstream>
 #include <stack>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <atomic>
+#include <fstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <xcb/xcb.h>
 #include <xcb/xcb_keysyms.h>
@@ -19,6 +43,7 @@
 #include <X11/keysym.h>
 #include <xcb/xcb_icccm.h>
 #include <xcb/randr.h>
+#include <xcb/sync.h>
 #include "shared.h"
 #include "config.h"
 
@@ -35,6 +60,51 @@ struct Coordinate {
     float Y;
 };
 
+/* The geometry of a window in pixels, as it is sent to the X server */
+struct Geometry {
+    int32_t X;
+    int32_t Y;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t BorderWidth;
+};
+
+/* A rectangle in pixels that a layout gives to a window, before padding and borders are taken off */
+struct LayoutRect {
+    float X;
+    float Y;
+    float Width;
+    float Height;
+};
+
+/* The parts of WM_NORMAL_HINTS the layout honours, so a client is given a size it accepts instead of rounding it and redrawing twice */
+struct SizeHints {
+    bool Set = false; // If the client gave any of them
+    int32_t BaseWidth = 0; // Size the increments count from
+    int32_t BaseHeight = 0;
+    int32_t MinWidth = 0;
+    int32_t MinHeight = 0;
+    int32_t MaxWidth = 0; // 0 if there's no maximum
+    int32_t MaxHeight = 0;
+    int32_t WidthIncrement = 0; // Eg. the cell size of a terminal, 0 if any size will do
+    int32_t HeightIncrement = 0;
+    float MinAspect = 0; // Height over width, 0 if the aspect ratio is free
+    float MaxAspect = 0; // Width over height
+};
+
+/* What we read from a client's properties as it's mapped */
+struct WindowProperties {
+    std::vector<xcb_atom_t> Types; // _NET_WM_WINDOW_TYPE
+    bool Fullscreen = false; // If _NET_WM_STATE asks for it
+    std::vector<xcb_atom_t> Protocols; // WM_PROTOCOLS
+    xcb_sync_counter_t SyncCounter = XCB_NONE; // _NET_WM_SYNC_REQUEST_COUNTER, if WM_PROTOCOLS has _NET_WM_SYNC_REQUEST and the server has SYNC
+    pid_t Pid = 0; // _NET_WM_PID, 0 if it isn't set or the client is on another machine
+    std::string Class; // WM_CLASS
+    std::string Instance;
+    std::string Title; // _NET_WM_NAME, or WM_NAME if it isn't set
+    SizeHints Hints; // WM_NORMAL_HINTS
+};
+
 /* Enums that specify the segment of a window */
 enum WindowSegment {
     LEFT, // Remaining 2/4 middle left
@@ -57,6 +127,28 @@ struct Window {
     bool Floating = false;
     Coordinate Position; // scale of 0 to 1
     Coordinate Size; // Width, Height, scale of 0 to 1
+
+    // What the X server was last told, so the commit scheduler can pace and interpolate changes
+    Geometry CommittedGeometry = {};
+    bool HasCommittedGeometry = false;
+    bool Offscreen = false; // If the last commit moved the window off screen
+    uint64_t LastCommitTime = 0; // Monotonic time in nanoseconds
+
+    // _NET_WM_SYNC_REQUEST, clients that support it are only resized again once they have drawn the last size
+    xcb_sync_counter_t SyncCounter = XCB_NONE; // Counter the client sets after it redraws, XCB_NONE if it doesn't support the protocol
+    xcb_sync_alarm_t SyncAlarm = XCB_NONE; // Fires when the counter reaches SyncValue
+    int64_t SyncValue = 0; // Value the client was last asked to set the counter to
+    uint64_t SyncRequestTime = 0; // When the last request was sent, 0 if the client isn't being waited on
+
+    SizeHints Hints; // Read as it's mapped, and again only when the client changes them
+
+    int IgnoreUnmaps = 0; // Unmaps we made ourselves to hide a tab, which OnUnMapNotify shouldn't take as the client going away
+
+    // The client's process, so its workspace can throttle it while hidden
+    pid_t Pid = 0; // From _NET_WM_PID as it was mapped, 0 if it's unknown or on another machine
+    bool ThrottleExempt = false; // If its WM_CLASS is in ThrottleExempt
+
+    WindowProperties Properties; // As they were read when it was mapped, so the WM can map it again (eg. to float it) without reading them again
 };
 
 /* Each window struct has an associated Container. This is because we have a tree structure of containers, that define how windows should be split and positioned
@@ -71,6 +163,14 @@ struct Container {
     std::shared_ptr<Container> Right = nullptr;
 
     std::shared_ptr<Window> Value = nullptr;
+    std::vector<std::shared_ptr<Window>> Tabs; // Only for tabbed containers, every window they hold in order. Value is the one shown, the rest are unmapped
+
+    std::shared_ptr<struct Monitor> IndexedMonitor = nullptr; // The monitor whose spatial index holds this container, if any
+
+    // Links of the workspace's focus history, only for containers that hold a window
+    std::shared_ptr<Container> FocusOlder = nullptr;
+    std::weak_ptr<Container> FocusNewer; // Weak, so the list doesn't keep removed containers alive
+    bool InFocusHistory = false;
 };
 
 /* The struct that defines each workspace. Each workspace has a root container, which represents the root node of the heirarchy tree */
@@ -78,8 +178,48 @@ struct Workspace {
     std::shared_ptr<Container> RootContainer = nullptr;
     std::vector<std::shared_ptr<Container>> FloatingContainers;
     std::shared_ptr<Container> FullscreenContainer = nullptr; // If there is a window that is fullscreened on the workspace
+    std::vector<xcb_window_t> StackingOrder; // Bottom to top order of the workspace's windows, as it was last applied to the X server
+    std::string Layout = Runtime.Settings.DefaultLayout; // Name of the layout in Layouts that places the tiled windows
+    float MasterRatio = 0.5; // Share of the width the master window gets, in layouts that have one
+    std::string Throttle = Runtime.Settings.BackgroundThrottle; // What happens to the processes of the windows while the workspace is hidden
+
+    // Every window container of the workspace, most recently focused first, so focus can fall back without searching for a window
+    std::shared_ptr<Container> FocusHistory = nullptr;
+    std::weak_ptr<Container> FocusHistoryTail; // Least recently focused, windows that were never focused join here
+
+    // Layout is lazy, it only runs for workspaces that are on a monitor
+    bool LayoutDirty = false; // If the tree changed since the workspace was last laid out, eg. while it was hidden or covered by a fullscreen window
+    std::shared_ptr<struct Monitor> LaidOutOn = nullptr; // Monitor the windows are laid out for, nullptr while they're offscreen
+
+    bool ClientsChanged = false; // If windows were added to or removed from the workspace since the client list was last published
+    std::vector<xcb_window_t> PublishedClients; // The workspace's part of the published client list
+};
+
+/* Where a layout wants new tiled windows to go in the container tree */
+enum InsertionPolicy {
+    SPLIT_FOCUSED, // Split the focused window on the side the cursor is in
+    SPLIT_SHALLOWEST, // Split the least nested window, keeping the depth of the tree logarithmic
+    AFTER_FOCUSED, // Only the order of the windows matters, put it after the focused window
+};
+
+/* A layout gives every tiled window from the base container down a rectangle within the area, in a single pass */
+struct Layout {
+    InsertionPolicy Insertion;
+    bool FollowsTree; // If the rectangles come from the tree's splits and ratios, which lets subtrees be laid out on their own
+    std::function<void(std::shared_ptr<Container> BaseContainer, LayoutRect Area, std::shared_ptr<Workspace> TargetWorkspace, std::vector<std::pair<std::shared_ptr<Container>, LayoutRect>> &Output)> Arrange;
+};
+
+/* The rectangles the layout gave to the tiled windows of a monitor, sorted by each of their edges, so the neighbour of a window in a direction is a binary search away */
+struct SpatialIndex {
+    std::multimap<int32_t, std::shared_ptr<Container>> LeftEdges;
+    std::multimap<int32_t, std::shared_ptr<Container>> RightEdges;
+    std::multimap<int32_t, std::shared_ptr<Container>> TopEdges;
+    std::multimap<int32_t, std::shared_ptr<Container>> BottomEdges;
+    std::unordered_map<std::shared_ptr<Container>, Geometry> Rects;
 };
 
+const float DEFAULT_REFRESH_RATE = 60; // Used if RandR doesn't report a usable mode, or the window isn't on any monitor
+
 /* The struct containing information about monitors */
 struct Monitor {
     xcb_randr_output_t Output; // Each monitor has a unique output identifier, essentially an id
@@ -89,6 +229,15 @@ struct Monitor {
     int Width;
     int Height;
     int ActiveWorkspace = -1; // Workspace being displayed on the monitor
+    float RefreshRate = DEFAULT_REFRESH_RATE; // In Hz, as reported by RandR for the monitor's current mode
+    SpatialIndex Index; // Tiled windows of the active workspace
+};
+
+/* Where the cursor is, as learnt from the events we already get, so finding it doesn't need a round trip to the X server */
+struct CursorState {
+    Coordinate Position;
+    std::shared_ptr<Monitor> CurrentMonitor = nullptr; // Monitor the position is on
+    bool Stale = true; // If the cursor may have moved since the position was recorded, the next lookup has to ask the X server
 };
 
 /* Protocols that we support / need */
@@ -97,10 +246,54 @@ struct Protocols {
     xcb_atom_t DeleteWindow;
     xcb_atom_t NetWmState;
     xcb_atom_t NetWmStateFullscreen;
+    xcb_atom_t NetWmStateHidden;
     xcb_atom_t NetWmWindowTypeDialog;
     xcb_atom_t NetWmWindowTypeUtility;
     xcb_atom_t NetWmWindowTypeSplash;
     xcb_atom_t NetWmWindowType;
+    xcb_atom_t NetWmBypassCompositor;
+    xcb_atom_t NetWmSyncRequest;
+    xcb_atom_t NetWmSyncRequestCounter;
+    xcb_atom_t NetWmPid;
+    xcb_atom_t Floating; // Our own, tells other programs (eg. picom rules) if a window is floating
+
+    // EWMH root properties that we publish
+    xcb_atom_t NetSupported;
+    xcb_atom_t NetSupportingWmCheck;
+    xcb_atom_t NetWmName;
+    xcb_atom_t Utf8String;
+    xcb_atom_t NetClientList;
+    xcb_atom_t NetActiveWindow;
+    xcb_atom_t NetNumberOfDesktops;
+    xcb_atom_t NetDesktopNames;
+    xcb_atom_t NetCurrentDesktop;
+    xcb_atom_t ExertCurrentDesktops; // Not in EWMH, _NET_CURRENT_DESKTOP only has room for one, so this holds the workspace of every monitor
+};
+
+/* The config's window rules, indexed by the first thing each rule matches on, so a window only checks the rules that could match it instead of all of them */
+struct CompiledRules {
+    std::unordered_map<std::string, std::vector<int>> ByClass;
+    std::unordered_map<std::string, std::vector<int>> ByInstance;
+    std::unordered_map<std::string, std::vector<int>> ByTitle;
+    std::unordered_map<xcb_atom_t, std::vector<int>> ByWindowType;
+    std::vector<int> MatchAll; // Rules without anything to match on
+    std::vector<xcb_atom_t> WindowTypes; // Interned WindowType of each rule, XCB_NONE if it has none
+};
+
+/* What the rules decided for a window */
+struct RuleOutcome {
+    int Workspace = -1;
+    int Floating = -1;
+    Coordinate Size = {0, 0};
+};
+
+/* What was last written to the EWMH root properties, so each iteration of the event loop only rewrites the ones that changed */
+struct EWMHState {
+    xcb_window_t CheckWindow = XCB_NONE; // Child window that proves a compliant WM is running
+    xcb_window_t ActiveWindow = XCB_NONE;
+    int CurrentDesktop = -1;
+    std::vector<uint32_t> CurrentDesktops; // Active workspace of each monitor, in the order of WM.Monitors
+    size_t Desktops = 0;
 };
 
 /* The main Window manager structure for information */
@@ -113,44 +306,186 @@ struct WM {
     std::vector<std::shared_ptr<Workspace>> Workspaces; // All the workspace structs. The index refers to which workspace it is (eg. index 0 is workspace 0);
 
     Protocols ProtocolsContainer; // The previously mentioned protocols
+    CursorState Cursor; // Cached cursor position
+    EWMHState Published; // EWMH properties as the X server has them
 };
 
 const float OFFSCREEN_WINDOW_MULTIPLIER = 1.5;
 const float RESIZE_INCREMEMNT = 0.01;
+const int NEIGHBOUR_TOLERANCE = 2; // Pixels that edges can be apart by and still count as touching, to absorb rounding in the layouts
+const int REBALANCE_MINIMUM_DEPTH = 8; // Trees of layouts that only care about order aren't rebuilt until they are at least this deep
+const size_t SUBSCRIBER_QUEUE_LENGTH = 256; // Messages a subscriber can fall behind by before the oldest are dropped
+const uint64_t SYNC_REQUEST_TIMEOUT = 100000000; // Nanoseconds a client gets to answer a sync request before it's resized without waiting
 
 static WM WM;
+static CompiledRules WindowRules;
 
 static bool Repositioning;
 static std::shared_ptr<Container> DraggedWindow = nullptr;
 static Coordinate InitialDraggingPosition;
 
+/* A geometry change that has been requested but not yet sent to the X server */
+struct PendingCommit {
+    std::shared_ptr<Window> Target;
+    Geometry From; // Where an animation started from
+    Geometry To; // Where the window should end up
+    int Frame = 0; // Frames of the animation that have been committed so far
+    int Frames = 1; // Total frames of the animation, 1 means no interpolation
+    uint64_t FrameInterval; // Nanoseconds between commits, from the refresh rate of the target monitor
+    uint64_t Deadline; // Monotonic time in nanoseconds that the next commit is allowed at
+};
+
+static std::unordered_map<xcb_window_t, PendingCommit> PendingCommits;
+static int CommitTimer = -1; // timerfd that wakes the event loop when the next pending commit is due
+static uint8_t SyncEventBase = 0; // First event of the SYNC extension, 0 if the server doesn't have it
+static std::unordered_map<xcb_sync_alarm_t, std::shared_ptr<Window>> SyncAlarms; // So an alarm event can find the window it's for
+
+/* What to do if a request fails. Requests are sent without waiting on them, so a failure only shows up later in the event stream, tagged with the sequence number of the request */
+struct ErrorHandler {
+    xcb_window_t Window = XCB_NONE; // Client window the request was about, dropped from the WM if the error says it no longer exists
+    std::function<void(const xcb_generic_error_t* Error)> Handler = nullptr;
+};
+
+static std::map<uint32_t, ErrorHandler> ErrorHandlers; // Keyed by request sequence number
+
+/* Owns a reply, event or error that XCB allocated, and frees it however the scope is left */
+struct XcbFree {
+    void operator()(void* Pointer) const { free(Pointer); }
+};
+
+template <typename T>
+using XcbPointer = std::unique_ptr<T, XcbFree>;
+
+// ! TRACING
+uint64_t GetMonotonicTime() {
+    timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return static_cast<uint64_t>(Time.tv_sec) * 1000000000 + Time.tv_nsec;
+}
+
+/* One finished span of WM work, in the shape of a Chrome trace "complete" event.
+The property worker records spans too, so the fields are relaxed atomics and Recorded says which span the slot holds once it's fully written */
+struct TraceEvent {
+    std::atomic<const char*> Name{nullptr}; // Has to outlive the buffer, so only string literals and InternalCommand names
+    std::atomic<const char*> Category{nullptr};
+    std::atomic<uint64_t> Start{0}; // Monotonic time in nanoseconds
+    std::atomic<uint64_t> Duration{0};
+    std::atomic<uint32_t> Thread{0};
+    std::atomic<uint64_t> Recorded{0}; // Index of the span plus one, 0 while a writer is filling the slot in
+};
+
+/* The most recent spans, in a fixed size ring. Writers claim a slot with a single atomic increment and never wait on anything, once it's full the oldest spans are overwritten */
+struct TraceBuffer {
+    std::vector<TraceEvent> Events; // Sized from the config, empty while tracing is off
+    std::atomic<uint64_t> Next{0}; // Total spans ever recorded, the slot of the next one is this modulo the size
+};
+
+static TraceBuffer Trace;
+static std::atomic<uint32_t> NextTraceThread{0};
+thread_local uint32_t TraceThread = NextTraceThread++;
+
+/* Records the time between its creation and the end of its scope, or End if that comes first. Costs one branch when tracing is off */
+struct TraceScope {
+    const char* Name;
+    const char* Category;
+    uint64_t Start;
+
+    TraceScope(const char* Name, const char* Category) : Name(Name), Category(Category), Start(Trace.Events.empty() ? 0 : GetMonotonicTime()) {}
+    ~TraceScope() { End(); }
+
+    void End() {
+        if (Start == 0) { return; }
+        uint64_t Index = Trace.Next.fetch_add(1, std::memory_order_relaxed);
+        TraceEvent &Event = Trace.Events[Index % Trace.Events.size()];
+        Event.Recorded.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release); // DumpTrace must not see the new fields with the old Recorded
+        Event.Name.store(Name, std::memory_order_relaxed);
+        Event.Category.store(Category, std::memory_order_relaxed);
+        Event.Start.store(Start, std::memory_order_relaxed);
+        Event.Duration.store(GetMonotonicTime() - Start, std::memory_order_relaxed);
+        Event.Thread.store(TraceThread, std::memory_order_relaxed);
+        Event.Recorded.store(Index + 1, std::memory_order_release);
+        Start = 0;
+    }
+};
+
+/* Writes the buffered spans as Chrome trace-event JSON, which Perfetto and chrome://tracing can open */
+void DumpTrace(const std::string &Path) {
+    if (Trace.Events.empty()) {
+        std::cerr << "Tracing is off, set TraceEvents in the config to record spans" << std::endl;
+        return;
+    }
+    std::ofstream File(Path);
+    if (!File) {
+        std::cerr << "Failed to open " << Path << " to dump the trace into" << std::endl;
+        return;
+    }
+
+    uint64_t Recorded = Trace.Next.load(std::memory_order_relaxed);
+    uint64_t Size = Trace.Events.size();
+    uint64_t First = (Recorded > Size) ? Recorded - Size : 0; // Oldest span that hasn't been overwritten
+    uint64_t Dumped = 0;
+    File << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (uint64_t i = First; i < Recorded; i++) {
+        // Spans the worker is still writing, or has already overwritten, are skipped rather than dumped half written
+        const TraceEvent &Event = Trace.Events[i % Size];
+        if (Event.Recorded.load(std::memory_order_acquire) != i + 1) { continue; }
+        const char* Name = Event.Name.load(std::memory_order_relaxed);
+        const char* Category = Event.Category.load(std::memory_order_relaxed);
+        uint64_t Start = Event.Start.load(std::memory_order_relaxed);
+        uint64_t Duration = Event.Duration.load(std::memory_order_relaxed);
+        uint32_t Thread = Event.Thread.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (Event.Recorded.load(std::memory_order_relaxed) != i + 1) { continue; }
+
+        File << ((Dumped == 0) ? "" : ",") << "\n{\"name\":\"" << Name << "\",\"cat\":\"" << Category << "\",\"ph\":\"X\",\"ts\":" << (Start / 1000.0)
+        << ",\"dur\":" << (Duration / 1000.0) << ",\"pid\":" << getpid() << ",\"tid\":" << Thread << "}";
+        Dumped++;
+    }
+    File << "\n]}\n";
+    std::cout << "Dumped " << Dumped << " trace events to " << Path << std::endl;
+}
+
+void FlushConnection() {
+    TraceScope Scope("xcb_flush", "flush");
+    xcb_flush(WM.Connection);
+}
+
 // ! UTILITY FUNCTIONS
 xcb_atom_t GetAtom(std::string AtomName) {
-    xcb_intern_atom_reply_t* Atom = xcb_intern_atom_reply(WM.Connection, xcb_intern_atom(WM.Connection, 0, strlen(AtomName.c_str()), AtomName.c_str()), nullptr);
+    TraceScope Scope("GetAtom", "reply");
+    XcbPointer<xcb_intern_atom_reply_t> Atom(xcb_intern_atom_reply(WM.Connection, xcb_intern_atom(WM.Connection, 0, strlen(AtomName.c_str()), AtomName.c_str()), nullptr));
     if (!Atom) {
         std::cerr << "Failed to get Atom: " << AtomName << " [EXIT]" << std::endl;
+        exit(EXIT_FAILURE);
     }
-    xcb_atom_t ReturnAtom = Atom->atom;
-    free(Atom); 
-    return ReturnAtom;
+    return Atom->atom;
 }
 
-bool DoesWindowSupportProtocol(xcb_window_t Window, xcb_atom_t Atom) {
-    xcb_icccm_get_wm_protocols_reply_t Protocols;
-    xcb_get_property_cookie_t Cookie = xcb_icccm_get_wm_protocols(WM.Connection, Window, WM.ProtocolsContainer.Protocols);
-    if (xcb_icccm_get_wm_protocols_reply(WM.Connection, Cookie, &Protocols, NULL) != 1) {
-        return false;
+/* Tells the client and the compositor whether the window is fullscreen. With the bypass set, compositors like picom unredirect the window so its frames skip compositing */
+void SetWindowFullscreenHints(xcb_window_t Window, bool Fullscreen) {
+    if (Fullscreen) {
+        uint32_t Bypass = 1;
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, Window, WM.ProtocolsContainer.NetWmState, XCB_ATOM_ATOM, 32, 1, &WM.ProtocolsContainer.NetWmStateFullscreen);
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, Window, WM.ProtocolsContainer.NetWmBypassCompositor, XCB_ATOM_CARDINAL, 32, 1, &Bypass);
+    } else {
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, Window, WM.ProtocolsContainer.NetWmState, XCB_ATOM_ATOM, 32, 0, nullptr);
+        xcb_delete_property(WM.Connection, Window, WM.ProtocolsContainer.NetWmBypassCompositor);
     }
+}
 
-     for (unsigned int i = 0; i < Protocols.atoms_len; i++) {
-            if (Protocols.atoms[i] == Atom) {
-                xcb_icccm_get_wm_protocols_reply_wipe(&Protocols);
-                return true;
-            }
-     }
+/* A window request that fails because the client died in the meantime drops the window instead of leaving it in the tree */
+void DropWindowOnError(xcb_void_cookie_t Cookie, xcb_window_t Window) {
+    ErrorHandlers[Cookie.sequence].Window = Window;
+}
 
-    xcb_icccm_get_wm_protocols_reply_wipe(&Protocols);
-    return false;
+void OnRequestError(xcb_void_cookie_t Cookie, std::function<void(const xcb_generic_error_t* Error)> Handler) {
+    ErrorHandlers[Cookie.sequence].Handler = Handler;
+}
+
+/* Errors come back in the order requests were sent, so once something from a later request has arrived, any earlier request without an error has succeeded */
+void PruneErrorHandlers(uint32_t Sequence) {
+    ErrorHandlers.erase(ErrorHandlers.begin(), ErrorHandlers.lower_bound(Sequence));
 }
 
 void PrintVisibleWindows() {
@@ -189,6 +524,15 @@ void PrintVisibleWindows() {
     std::cout << std::endl;
 }
 
+/* The window of a container with the given id, which can be one of its hidden tabs */
+std::shared_ptr<Window> GetContainerWindow_PossibleNullptr(std::shared_ptr<Container> TargetContainer, xcb_window_t Window) {
+    if (TargetContainer->Value->Window == Window) { return TargetContainer->Value; }
+    for (auto &Tab: TargetContainer->Tabs) {
+        if (Tab->Window == Window) { return Tab; }
+    }
+    return nullptr;
+}
+
 std::shared_ptr<WindowMetadata> GetWorkspaceAndContainerFromWindow_PossibleNullptr(xcb_window_t Window) {
     std::shared_ptr<WindowMetadata> Metadata = std::make_shared<WindowMetadata>();
     for (int i = 0; i < static_cast<int>(WM.Workspaces.size()); i++) {
@@ -202,7 +546,7 @@ std::shared_ptr<WindowMetadata> GetWorkspaceAndContainerFromWindow_PossibleNullp
                 Stack.pop();
 
                 if (CurrentContainer->Direction == NONE) {
-                    if (CurrentContainer->Value->Window == Window) {
+                    if (GetContainerWindow_PossibleNullptr(CurrentContainer, Window) != nullptr) {
                         Metadata->Container = CurrentContainer;
                         Metadata->Workspace = i;
                         return Metadata;
@@ -237,15 +581,12 @@ std::shared_ptr<WindowMetadata> GetWorkspaceAndContainerFromWindow_PossibleNullp
 }
 
 unsigned int KeysymToKeycode(const unsigned int Keysym) {
-    xcb_keycode_t* Keycodes = xcb_key_symbols_get_keycode(WM.Keysyms, Keysym);
+    XcbPointer<xcb_keycode_t> Keycodes(xcb_key_symbols_get_keycode(WM.Keysyms, Keysym));
     if (!Keycodes) {
         std::cerr << "Failed to get keycode for keysym: " << Keysym << " [EXIT] " << std::endl;
         exit(EXIT_FAILURE);
     }
-
-    xcb_keycode_t PrimaryKeycode = Keycodes[0]; // The first keycode is the main one
-    free(Keycodes);
-    return PrimaryKeycode;
+    return Keycodes.get()[0]; // The first keycode is the main one
 }
 
 unsigned int KeycodeToKeysym(const unsigned int Keycode) {
@@ -266,10 +607,76 @@ std::shared_ptr<Monitor> GetMonitorFromWorkspace_PossibleNullptr(int Workspace)
     return nullptr;
 }
 
-void SendWindowToFront(xcb_window_t Window) {
-    uint32_t Parameters[] = { XCB_STACK_MODE_ABOVE };
-    xcb_configure_window(WM.Connection, Window, XCB_CONFIG_WINDOW_STACK_MODE, Parameters);
-    xcb_flush(WM.Connection);
+/* Bottom to top order the windows of a workspace should be in. Tiled windows are at the bottom, then floating windows (in the order of FloatingContainers), then the fullscreened window at the very top */
+std::vector<xcb_window_t> GetDesiredStackingOrder(std::shared_ptr<Workspace> TargetWorkspace) {
+    std::vector<xcb_window_t> Order;
+    if (TargetWorkspace->RootContainer != nullptr) {
+        std::stack<std::shared_ptr<Container>> Stack;
+        Stack.push(TargetWorkspace->RootContainer);
+        while (!Stack.empty()) {
+            std::shared_ptr<Container> CurrentContainer = Stack.top();
+            Stack.pop();
+            if (CurrentContainer->Direction == NONE) {
+                if (CurrentContainer != TargetWorkspace->FullscreenContainer) { Order.push_back(CurrentContainer->Value->Window); }
+            } else {
+                if (CurrentContainer->Right != nullptr) { Stack.push(CurrentContainer->Right); }
+                if (CurrentContainer->Left != nullptr) { Stack.push(CurrentContainer->Left); }
+            }
+        }
+    }
+
+    for (auto Floater: TargetWorkspace->FloatingContainers) {
+        if (Floater != TargetWorkspace->FullscreenContainer) { Order.push_back(Floater->Value->Window); }
+    }
+
+    if (TargetWorkspace->FullscreenContainer != nullptr) { Order.push_back(TargetWorkspace->FullscreenContainer->Value->Window); }
+    return Order;
+}
+
+/* Brings the X server's stacking order of the workspace in line with the desired order. The windows that are already in the right relative order (the longest increasing run of
+their previous positions) are left alone, every other window is restacked directly above its new lower neighbour, so only the windows that actually changed position cost a request */
+void RestackWorkspace(std::shared_ptr<Workspace> TargetWorkspace) {
+    TraceScope Scope("RestackWorkspace", "layout");
+    std::vector<xcb_window_t> Desired = GetDesiredStackingOrder(TargetWorkspace);
+    std::unordered_map<xcb_window_t, int> PreviousPositions;
+    for (int i = 0; i < static_cast<int>(TargetWorkspace->StackingOrder.size()); i++) {
+        PreviousPositions[TargetWorkspace->StackingOrder[i]] = i;
+    }
+
+    // Longest increasing subsequence of previous positions, windows we don't know the position of (eg. newly mapped) are never kept
+    std::vector<int> Tails; // Index into Desired of the smallest tail of each run length
+    std::vector<int> Predecessors(Desired.size(), -1);
+    for (int i = 0; i < static_cast<int>(Desired.size()); i++) {
+        auto Found = PreviousPositions.find(Desired[i]);
+        if (Found == PreviousPositions.end()) { continue; }
+        auto Position = std::lower_bound(Tails.begin(), Tails.end(), Found->second, [&](int TailIndex, int Value) { return PreviousPositions[Desired[TailIndex]] < Value; });
+        if (Position != Tails.begin()) { Predecessors[i] = *(Position - 1); }
+        if (Position == Tails.end()) { Tails.push_back(i); } else { *Position = i; }
+    }
+
+    std::vector<bool> Keep(Desired.size(), false);
+    for (int i = Tails.empty() ? -1 : Tails.back(); i != -1; i = Predecessors[i]) { Keep[i] = true; }
+
+    int Restacked = 0;
+    for (int i = 0; i < static_cast<int>(Desired.size()); i++) {
+        if (Keep[i]) { continue; }
+        if (i > 0) {
+            uint32_t Parameters[] = { Desired[i - 1], XCB_STACK_MODE_ABOVE };
+            DropWindowOnError(xcb_configure_window(WM.Connection, Desired[i], XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE, Parameters), Desired[i]);
+        } else if (Desired.size() > 1) { // The bottom window goes below the first window that isn't moving, so it stays below everything that comes after it
+            auto FirstKept = std::find(Keep.begin(), Keep.end(), true);
+            uint32_t Sibling = (FirstKept != Keep.end()) ? Desired[FirstKept - Keep.begin()] : Desired[1];
+            uint32_t Parameters[] = { Sibling, XCB_STACK_MODE_BELOW };
+            DropWindowOnError(xcb_configure_window(WM.Connection, Desired[i], XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE, Parameters), Desired[i]);
+        }
+        Restacked++;
+    }
+
+    TargetWorkspace->StackingOrder = Desired;
+    if (Restacked > 0) {
+        FlushConnection();
+        std::cout << "Restacked " << Restacked << " of " << Desired.size() << " windows" << std::endl;
+    }
 }
 
 
@@ -284,14 +691,211 @@ unsigned int GetActiveWorkspaceEnsureValid(std::shared_ptr<Monitor> MonitorToChe
     }
 }
 
+/* Brings a size down to the nearest one the client's size hints allow, following ICCCM the same way dwm does. Minimum sizes win over the space the window was given */
+void ApplySizeHints(const SizeHints &Hints, uint32_t &Width, uint32_t &Height) {
+    if (!Hints.Set) { return; }
+    int32_t ConstrainedWidth = Width;
+    int32_t ConstrainedHeight = Height;
+    bool BaseIsMin = (Hints.BaseWidth == Hints.MinWidth && Hints.BaseHeight == Hints.MinHeight);
+    if (!BaseIsMin) { // The aspect ratio is of the size without the base, unless the base is only standing in for the minimum
+        ConstrainedWidth -= Hints.BaseWidth;
+        ConstrainedHeight -= Hints.BaseHeight;
+    }
+    if (Hints.MinAspect > 0 && Hints.MaxAspect > 0 && ConstrainedWidth > 0 && ConstrainedHeight > 0) {
+        if (Hints.MaxAspect < static_cast<float>(ConstrainedWidth) / ConstrainedHeight) {
+            ConstrainedWidth = ConstrainedHeight * Hints.MaxAspect + 0.5f;
+        } else if (Hints.MinAspect < static_cast<float>(ConstrainedHeight) / ConstrainedWidth) {
+            ConstrainedHeight = ConstrainedWidth * Hints.MinAspect + 0.5f;
+        }
+    }
+    if (BaseIsMin) {
+        ConstrainedWidth -= Hints.BaseWidth;
+        ConstrainedHeight -= Hints.BaseHeight;
+    }
+    if (Hints.WidthIncrement > 0 && ConstrainedWidth > 0) { ConstrainedWidth -= ConstrainedWidth % Hints.WidthIncrement; }
+    if (Hints.HeightIncrement > 0 && ConstrainedHeight > 0) { ConstrainedHeight -= ConstrainedHeight % Hints.HeightIncrement; }
+    ConstrainedWidth = std::max(ConstrainedWidth + Hints.BaseWidth, Hints.MinWidth);
+    ConstrainedHeight = std::max(ConstrainedHeight + Hints.BaseHeight, Hints.MinHeight);
+    if (Hints.MaxWidth > 0) { ConstrainedWidth = std::min(ConstrainedWidth, Hints.MaxWidth); }
+    if (Hints.MaxHeight > 0) { ConstrainedHeight = std::min(ConstrainedHeight, Hints.MaxHeight); }
+    Width = std::max(1, ConstrainedWidth);
+    Height = std::max(1, ConstrainedHeight);
+}
+
+/* Buffers a geometry change, the X server is only told about it when CommitPendingGeometry runs and the window hasn't been committed to within the last frame of its monitor */
+void QueueWindowGeometry(std::shared_ptr<Window> TargetWindow, Geometry Target, float RefreshRate, bool Animate) {
+    uint64_t FrameInterval = 1000000000 / (RefreshRate > 0 ? RefreshRate : DEFAULT_REFRESH_RATE);
+    int Frames = (Animate && TargetWindow->HasCommittedGeometry && !TargetWindow->Offscreen && Runtime.Settings.AnimationFrames > 1) ? Runtime.Settings.AnimationFrames : 1;
+
+    auto Found = PendingCommits.find(TargetWindow->Window);
+    if (Found != PendingCommits.end()) { // Coalesce with what's already waiting, the deadline doesn't move
+        PendingCommit &Pending = Found->second;
+        if (Frames > 1) { Pending.From = TargetWindow->CommittedGeometry; Pending.Frame = 0; }
+        Pending.To = Target;
+        Pending.Frames = Frames;
+        Pending.FrameInterval = FrameInterval;
+        return;
+    }
+
+    if (TargetWindow->HasCommittedGeometry && std::memcmp(&TargetWindow->CommittedGeometry, &Target, sizeof(Geometry)) == 0) { return; }
+
+    PendingCommit Pending;
+    Pending.Target = TargetWindow;
+    Pending.From = TargetWindow->CommittedGeometry;
+    Pending.To = Target;
+    Pending.Frames = Frames;
+    Pending.FrameInterval = FrameInterval;
+    Pending.Deadline = std::max(GetMonotonicTime(), TargetWindow->LastCommitTime + FrameInterval);
+    PendingCommits[TargetWindow->Window] = Pending;
+}
+
+/* Watches the client's sync counter with an alarm, which stays inactive until SendSyncRequest gives it a value to wait for */
+void SetupSyncAlarm(std::shared_ptr<Window> TargetWindow, xcb_sync_counter_t Counter) {
+    TargetWindow->SyncCounter = Counter;
+    TargetWindow->SyncAlarm = xcb_generate_id(WM.Connection);
+    uint32_t Values[] = {Counter, XCB_SYNC_VALUETYPE_ABSOLUTE, 0, 0, XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON, 0, 0, 1}; // Value and delta are hi, lo pairs
+    xcb_sync_create_alarm(WM.Connection, TargetWindow->SyncAlarm, XCB_SYNC_CA_COUNTER | XCB_SYNC_CA_VALUE_TYPE | XCB_SYNC_CA_VALUE | XCB_SYNC_CA_TEST_TYPE | XCB_SYNC_CA_DELTA | XCB_SYNC_CA_EVENTS, Values);
+    SyncAlarms[TargetWindow->SyncAlarm] = TargetWindow;
+    std::cout << "Window " << TargetWindow->Window << " supports _NET_WM_SYNC_REQUEST, counter: " << Counter << std::endl;
+}
+
+void DestroySyncAlarm(std::shared_ptr<Window> TargetWindow) {
+    if (TargetWindow->SyncAlarm == XCB_NONE) { return; }
+    xcb_sync_destroy_alarm(WM.Connection, TargetWindow->SyncAlarm); // Fails harmlessly if the counter died with the client and took the alarm with it
+    SyncAlarms.erase(TargetWindow->SyncAlarm);
+    TargetWindow->SyncAlarm = XCB_NONE;
+    TargetWindow->SyncCounter = XCB_NONE;
+    TargetWindow->SyncRequestTime = 0;
+}
+
+/* Asks the client to set its counter to the next value once it has drawn the size that follows, and arms the alarm for that value.
+The delta is 0 so the alarm deactivates after it fires, until the next request re-arms it */
+void SendSyncRequest(std::shared_ptr<Window> TargetWindow, uint64_t Now) {
+    TargetWindow->SyncValue++;
+    uint32_t High = static_cast<uint32_t>(TargetWindow->SyncValue >> 32);
+    uint32_t Low = static_cast<uint32_t>(TargetWindow->SyncValue & 0xffffffff);
+
+    xcb_client_message_event_t Event = {};
+    Event.response_type = XCB_CLIENT_MESSAGE;
+    Event.format = 32;
+    Event.window = TargetWindow->Window;
+    Event.type = WM.ProtocolsContainer.Protocols;
+    Event.data.data32[0] = WM.ProtocolsContainer.NetWmSyncRequest;
+    Event.data.data32[1] = XCB_CURRENT_TIME;
+    Event.data.data32[2] = Low;
+    Event.data.data32[3] = High;
+    DropWindowOnError(xcb_send_event(WM.Connection, false, TargetWindow->Window, XCB_EVENT_MASK_NO_EVENT, (const char*)&Event), TargetWindow->Window);
+
+    uint32_t Values[] = {High, Low, 0, 0};
+    xcb_sync_change_alarm(WM.Connection, TargetWindow->SyncAlarm, XCB_SYNC_CA_VALUE | XCB_SYNC_CA_DELTA, Values);
+    TargetWindow->SyncRequestTime = Now;
+}
+
+/* Tells the X server a window's geometry and records it as what was last committed */
+void SendWindowGeometry(std::shared_ptr<Window> TargetWindow, Geometry Commit, uint64_t Now) {
+    uint32_t Parameters[] = {static_cast<uint32_t>(Commit.X), static_cast<uint32_t>(Commit.Y), Commit.Width, Commit.Height, Commit.BorderWidth};
+    DropWindowOnError(xcb_configure_window(WM.Connection, TargetWindow->Window, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT | XCB_CONFIG_WINDOW_BORDER_WIDTH, Parameters), TargetWindow->Window);
+    TargetWindow->CommittedGeometry = Commit;
+    TargetWindow->HasCommittedGeometry = true;
+    TargetWindow->LastCommitTime = Now;
+}
+
+/* Sends a window's pending geometry straight away, without frame pacing, animation or waiting on its sync request. For windows about to be mapped, which must not appear at their old geometry */
+void CommitWindowGeometryNow(std::shared_ptr<Window> TargetWindow) {
+    auto Pending = PendingCommits.find(TargetWindow->Window);
+    if (Pending == PendingCommits.end()) { return; }
+    SendWindowGeometry(TargetWindow, Pending->second.To, GetMonotonicTime());
+    PendingCommits.erase(Pending); // The commit timer may still wake us for it, CommitPendingGeometry then just re-arms it
+}
+
+/* Sends every pending geometry change whose deadline has passed in one flush, and arms the commit timer for whatever is left.
+Windows that are still drawing the last size they were sent keep their change pending until they answer or time out */
+void CommitPendingGeometry() {
+    TraceScope Scope("CommitPendingGeometry", "layout");
+    if (PendingCommits.empty()) { return; }
+    uint64_t Now = GetMonotonicTime();
+    uint64_t NextDeadline = UINT64_MAX;
+
+    for (auto Iterator = PendingCommits.begin(); Iterator != PendingCommits.end();) {
+        PendingCommit &Pending = Iterator->second;
+        if (Pending.Deadline > Now) {
+            NextDeadline = std::min(NextDeadline, Pending.Deadline);
+            Iterator++;
+            continue;
+        }
+        if (Pending.Target->SyncRequestTime != 0) {
+            if (Now - Pending.Target->SyncRequestTime < SYNC_REQUEST_TIMEOUT) { // The alarm event will bring us back here
+                NextDeadline = std::min(NextDeadline, Pending.Target->SyncRequestTime + SYNC_REQUEST_TIMEOUT);
+                Iterator++;
+                continue;
+            }
+            std::cerr << "Window " << Pending.Target->Window << " didn't answer its sync request in time, resizing it without waiting" << std::endl;
+            Pending.Target->SyncRequestTime = 0;
+        }
+
+        Pending.Frame++;
+        Geometry Commit = Pending.To;
+        if (Pending.Frame < Pending.Frames) {
+            float Progress = static_cast<float>(Pending.Frame) / Pending.Frames;
+            Commit.X = Pending.From.X + (Pending.To.X - Pending.From.X) * Progress;
+            Commit.Y = Pending.From.Y + (Pending.To.Y - Pending.From.Y) * Progress;
+            Commit.Width = Pending.From.Width + (static_cast<float>(Pending.To.Width) - Pending.From.Width) * Progress;
+            Commit.Height = Pending.From.Height + (static_cast<float>(Pending.To.Height) - Pending.From.Height) * Progress;
+            ApplySizeHints(Pending.Target->Hints, Commit.Width, Commit.Height); // Even the frames in between are sizes the client takes as they are
+        }
+
+        // Only a new size needs redrawing, and the first configure is before the window is mapped so there's nothing drawn to wait on
+        bool Resized = Pending.Target->HasCommittedGeometry && (Commit.Width != Pending.Target->CommittedGeometry.Width || Commit.Height != Pending.Target->CommittedGeometry.Height);
+        if (Resized && Pending.Target->SyncAlarm != XCB_NONE) { SendSyncRequest(Pending.Target, Now); }
+
+        SendWindowGeometry(Pending.Target, Commit, Now);
+
+        if (Pending.Frame < Pending.Frames) { // Animation still running, come back next frame
+            Pending.Deadline = Now + Pending.FrameInterval;
+            NextDeadline = std::min(NextDeadline, Pending.Deadline);
+            Iterator++;
+        } else {
+            Iterator = PendingCommits.erase(Iterator);
+        }
+    }
+    FlushConnection();
+
+    itimerspec Timer = {};
+    if (NextDeadline != UINT64_MAX) {
+        Timer.it_value.tv_sec = NextDeadline / 1000000000;
+        Timer.it_value.tv_nsec = NextDeadline % 1000000000;
+    }
+    timerfd_settime(CommitTimer, TFD_TIMER_ABSTIME, &Timer, nullptr); // A zeroed timer disarms it
+}
+
+std::shared_ptr<Monitor> GetMonitorFromPosition_PossibleNullptr(Coordinate Position) {
+    for (std::shared_ptr<Monitor> Monitor: WM.Monitors) {
+        int UpperBoundX = Monitor->Width + Monitor->X;
+        int UpperBoundY = Monitor->Height + Monitor->Y;
+        if ((Monitor->X <= Position.X) && (Position.X <= UpperBoundX) && (Monitor->Y <= Position.Y) && (Position.Y <= UpperBoundY)) {
+            return Monitor;
+        }
+    }
+    return nullptr;
+}
+
+/* Called with the root co-ordinates of every event that carries them. If they fall between monitors, the cursor is still counted as being on the last monitor it was on */
+void UpdateCursorPosition(int16_t X, int16_t Y) {
+    WM.Cursor.Position = {static_cast<float>(X), static_cast<float>(Y)};
+    std::shared_ptr<Monitor> Monitor = GetMonitorFromPosition_PossibleNullptr(WM.Cursor.Position);
+    if (Monitor != nullptr) { WM.Cursor.CurrentMonitor = Monitor; }
+    WM.Cursor.Stale = false;
+}
+
+/* Only asks the X server if a motion hint has told us the cursor moved since we last knew where it was. Querying also re-arms the motion hints */
 Coordinate GetCursorPosition() {
-    xcb_query_pointer_reply_t* Position = xcb_query_pointer_reply(WM.Connection, xcb_query_pointer(WM.Connection, WM.Screen->root), nullptr);
+    if (!WM.Cursor.Stale) { return WM.Cursor.Position; }
+    TraceScope Scope("xcb_query_pointer", "reply");
+
+    XcbPointer<xcb_query_pointer_reply_t> Position(xcb_query_pointer_reply(WM.Connection, xcb_query_pointer(WM.Connection, WM.Screen->root), nullptr));
     if (Position) {
-        Coordinate CursorPosition = {};
-        CursorPosition.X = Position->root_x;
-        CursorPosition.Y = Position->root_y;
-        free(Position);
-        return CursorPosition;
+        UpdateCursorPosition(Position->root_x, Position->root_y);
+        return WM.Cursor.Position;
     } else {
         std::cerr << "Failed to get the cursor position! [EXIT]" << std::endl;
         exit(EXIT_FAILURE);
@@ -299,276 +903,1618 @@ Coordinate GetCursorPosition() {
 }
 
 std::shared_ptr<Monitor> GetActiveMonitor() {
-    Coordinate CursorPosition = GetCursorPosition();
-    for (std::shared_ptr<Monitor> Monitor: WM.Monitors) {
-        int UpperBoundX = Monitor->Width + Monitor->X;
-        int UpperBoundY = Monitor->Height + Monitor->Y;
-        if ((Monitor->X <= CursorPosition.X) && (CursorPosition.X <= UpperBoundX) && (Monitor->Y <= CursorPosition.Y) && (CursorPosition.Y <= UpperBoundY)) {
-            std::cout << "Returning Active Monitor is: " << Monitor->Name << std::endl;
-            return Monitor;
-        }
+    GetCursorPosition();
+    if (WM.Cursor.CurrentMonitor != nullptr) {
+        std::cout << "Returning Active Monitor is: " << WM.Cursor.CurrentMonitor->Name << std::endl;
+        return WM.Cursor.CurrentMonitor;
     }
 
     std::cout << "No Active Monitor was found somehow! [EXIT]" << std::endl;
     exit(EXIT_FAILURE);
 }
 
-void UpdateWindowToCurrentSplits(std::shared_ptr<Container> TargetContainer, std::shared_ptr<Monitor> Monitor = nullptr) {
-    std::cout << "Updating to current splits: " << TargetContainer->Parent << " " << TargetContainer->Left << " " << TargetContainer->Right << " " << TargetContainer->Value->Window << std::endl;
-    
-    if (Monitor == nullptr) { // No monitor has been supplied, we have to calculate
-        Monitor = GetMonitorFromWorkspace_PossibleNullptr(GetWorkspaceAndContainerFromWindow_PossibleNullptr(TargetContainer->Value->Window)->Workspace);
-    }
+/* The geometry the window is showing, from what was last committed to it. The X server is only asked if we have never configured the window */
+Geometry GetWindowGeometry(std::shared_ptr<Window> TargetWindow) {
+    if (TargetWindow->HasCommittedGeometry) { return TargetWindow->CommittedGeometry; }
+    TraceScope Scope("xcb_get_geometry", "reply");
 
-    if (Monitor == nullptr) { // Workspace is off screen
-        std::cout << "Monitor is nullptr, and so is offscreen" << std::endl;
-        xcb_get_geometry_reply_t* WindowGeometry = xcb_get_geometry_reply(WM.Connection, xcb_get_geometry(WM.Connection, TargetContainer->Value->Window), NULL);
-        const uint32_t POS_TO_MOVE[] = {static_cast<uint32_t>(WindowGeometry->x), static_cast<uint32_t>(static_cast<uint32_t>(WindowGeometry->y) + (GetActiveMonitor()->Height * OFFSCREEN_WINDOW_MULTIPLIER))};
-        xcb_configure_window(WM.Connection, TargetContainer->Value->Window, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, &POS_TO_MOVE);
-        xcb_flush(WM.Connection);
-        return;
-    }
+    Geometry Result = {};
+    XcbPointer<xcb_get_geometry_reply_t> WindowGeometry(xcb_get_geometry_reply(WM.Connection, xcb_get_geometry(WM.Connection, TargetWindow->Window), NULL));
+    if (WindowGeometry) { Result = {WindowGeometry->x, WindowGeometry->y, WindowGeometry->width, WindowGeometry->height, WindowGeometry->border_width}; }
+    return Result;
+}
 
-    if (TargetContainer->Value == nullptr) {
-        std::cerr << "Target container has no value -- cannot proceed in positioning and sizing it! [EXIT]" << std::endl;
-        exit(EXIT_FAILURE);
+// ! SPATIAL INDEX
+void EraseFromEdges(std::multimap<int32_t, std::shared_ptr<Container>> &Edges, int32_t Edge, const std::shared_ptr<Container> &TargetContainer) {
+    auto Range = Edges.equal_range(Edge);
+    for (auto Iterator = Range.first; Iterator != Range.second; Iterator++) {
+        if (Iterator->second == TargetContainer) {
+            Edges.erase(Iterator);
+            return;
+        }
     }
+}
 
-    uint32_t X, Y, Width, Height;
-    X = Monitor->X; Y = Monitor->Y; Width = Monitor->Width; Height = Monitor->Height;
-    uint32_t BorderWidth = TargetContainer->Value->Floating ? Runtime.Settings.FloatingWindowBorderSize : Runtime.Settings.TiledWindowBorderSize;
+void UnindexContainer(std::shared_ptr<Container> TargetContainer) {
+    if (TargetContainer->IndexedMonitor == nullptr) { return; }
+    SpatialIndex &Index = TargetContainer->IndexedMonitor->Index;
+    auto Found = Index.Rects.find(TargetContainer);
+    if (Found != Index.Rects.end()) {
+        const Geometry &Rect = Found->second;
+        EraseFromEdges(Index.LeftEdges, Rect.X, TargetContainer);
+        EraseFromEdges(Index.RightEdges, Rect.X + Rect.Width, TargetContainer);
+        EraseFromEdges(Index.TopEdges, Rect.Y, TargetContainer);
+        EraseFromEdges(Index.BottomEdges, Rect.Y + Rect.Height, TargetContainer);
+        Index.Rects.erase(Found);
+    }
+    TargetContainer->IndexedMonitor = nullptr;
+}
 
-    // Ensure that the window isn't fullscreened
-    if (WM.Workspaces[GetActiveWorkspaceEnsureValid(Monitor)]->FullscreenContainer != TargetContainer) {
-        if (TargetContainer->Value->Floating != true) {
-            X += Runtime.Settings.MonitorPadding; Y += Runtime.Settings.MonitorPadding; Width -= (Runtime.Settings.MonitorPadding*2); Height -= (Runtime.Settings.MonitorPadding*2);
-            X -= (Runtime.Settings.WindowPadding/2); Y -= (Runtime.Settings.WindowPadding/2); Width += (Runtime.Settings.WindowPadding); Height += (Runtime.Settings.WindowPadding);
-            std::shared_ptr<Container>* CurrentContainer = &TargetContainer;
-            std::stack<std::shared_ptr<Container>> Stack;
-            while (true) {
-                Stack.push(*CurrentContainer);
-                std::cout << "Pushed " << CurrentContainer->get() << " onto the stack" << std::endl;
-                if (CurrentContainer->get()->Parent == nullptr) { break; }
-                CurrentContainer = &CurrentContainer->get()->Parent;
-            }
+void IndexContainer(std::shared_ptr<Container> TargetContainer, std::shared_ptr<Monitor> Monitor, Geometry Rect) {
+    if (TargetContainer->IndexedMonitor == Monitor) {
+        auto Found = Monitor->Index.Rects.find(TargetContainer);
+        if (Found != Monitor->Index.Rects.end() && std::memcmp(&Found->second, &Rect, sizeof(Geometry)) == 0) { return; } // Hasn't moved
+    }
 
-            while (Stack.size() > 1) { // Don't iterate over the base container
-                std::shared_ptr<Container> TopContainer = Stack.top();
-                Stack.pop();
+    UnindexContainer(TargetContainer);
+    Monitor->Index.LeftEdges.insert({Rect.X, TargetContainer});
+    Monitor->Index.RightEdges.insert({Rect.X + Rect.Width, TargetContainer});
+    Monitor->Index.TopEdges.insert({Rect.Y, TargetContainer});
+    Monitor->Index.BottomEdges.insert({Rect.Y + Rect.Height, TargetContainer});
+    Monitor->Index.Rects[TargetContainer] = Rect;
+    TargetContainer->IndexedMonitor = Monitor;
+}
 
-                if (TopContainer->Direction == VERTICAL) {
-                    if (TopContainer->Right == Stack.top()) { X += Width * (TopContainer->Ratio); Width *= (1-TopContainer->Ratio); } else { Width *= (TopContainer->Ratio); }
-                } else {
-                    if (TopContainer->Right == Stack.top()) { Y += Height * (TopContainer->Ratio); Height *= (1-TopContainer->Ratio); } else { Height *= (TopContainer->Ratio); }
-                }
-            }
-            X += (Runtime.Settings.WindowPadding/2); Y += (Runtime.Settings.WindowPadding/2); Width -= Runtime.Settings.WindowPadding; Height -= Runtime.Settings.WindowPadding;
-        } else { // Window is floating
-            X += (Width * TargetContainer->Value->Position.X); Y += (Height * TargetContainer->Value->Position.Y); Width *= TargetContainer->Value->Size.X; Height *= TargetContainer->Value->Size.Y;
-        }
-        std::cout << "Iter " << TargetContainer->Value->Window << " to current splits, PosX: " << X << ", PosY: " << Y << ", Width: " << Width << ", Height: " << Height << std::endl;
-        Width = Width-(2*BorderWidth);
-        Height = Height-(2*BorderWidth);
+/* The start and end of a rectangle along the axis that runs across a direction, eg. the vertical extent when moving left or right */
+void GetPerpendicularSpan(const Geometry &Rect, WindowSegment Direction, int32_t &Start, int32_t &End) {
+    if (Direction == LEFT || Direction == RIGHT) {
+        Start = Rect.Y; End = Rect.Y + Rect.Height;
     } else {
-        std::cout << "Setting fullscreened window to max res" << std::endl;
-        BorderWidth = 0;
+        Start = Rect.X; End = Rect.X + Rect.Width;
     }
+}
 
-    uint32_t Parameters[] = {X, Y, Width, Height, BorderWidth};
-    xcb_configure_window(WM.Connection, TargetContainer->Value->Window, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT | XCB_CONFIG_WINDOW_BORDER_WIDTH, Parameters);
-    xcb_flush(WM.Connection);
-    std::cout << "Updated Window " << TargetContainer->Value->Window << " to current splits, PosX: " << X << ", PosY: " << Y << ", Width: " << Width << ", Height: " << Height << std::endl;
+/* Finds the closest container past Edge in the direction, that overlaps the span across it. Prefers containers that cover the middle of the span */
+std::shared_ptr<Container> SearchSpatialIndex_PossibleNullptr(SpatialIndex &Index, WindowSegment Direction, int32_t Edge, int32_t SpanStart, int32_t SpanEnd, std::shared_ptr<Container> Exclude) {
+    std::shared_ptr<Container> Best = nullptr;
+    int32_t BestEdge = 0;
+    int32_t BestScore = 0;
+    int32_t Middle = (SpanStart + SpanEnd) / 2;
+
+    auto Consider = [&](int32_t CandidateEdge, const std::shared_ptr<Container> &Candidate) -> bool { // Returns false once nothing further can beat the best
+        if (Best != nullptr && std::abs(CandidateEdge - BestEdge) > NEIGHBOUR_TOLERANCE) { return false; }
+        if (Candidate == Exclude) { return true; }
+        int32_t CandidateStart, CandidateEnd;
+        GetPerpendicularSpan(Index.Rects[Candidate], Direction, CandidateStart, CandidateEnd);
+        if (CandidateEnd <= SpanStart || CandidateStart >= SpanEnd) { return true; }
+
+        int32_t Score = (CandidateStart <= Middle && Middle < CandidateEnd) ? 0 : std::min(std::abs(CandidateStart - Middle), std::abs(CandidateEnd - Middle));
+        if (Best == nullptr || Score < BestScore) { Best = Candidate; BestEdge = CandidateEdge; BestScore = Score; }
+        return true;
+    };
+
+    switch (Direction) {
+        case RIGHT: { for (auto Iterator = Index.LeftEdges.lower_bound(Edge - NEIGHBOUR_TOLERANCE); Iterator != Index.LeftEdges.end() && Consider(Iterator->first, Iterator->second); Iterator++) {} break; }
+        case DOWN: { for (auto Iterator = Index.TopEdges.lower_bound(Edge - NEIGHBOUR_TOLERANCE); Iterator != Index.TopEdges.end() && Consider(Iterator->first, Iterator->second); Iterator++) {} break; }
+        case LEFT: { for (auto Iterator = std::make_reverse_iterator(Index.RightEdges.upper_bound(Edge + NEIGHBOUR_TOLERANCE)); Iterator != Index.RightEdges.rend() && Consider(Iterator->first, Iterator->second); Iterator++) {} break; }
+        case UP: { for (auto Iterator = std::make_reverse_iterator(Index.BottomEdges.upper_bound(Edge + NEIGHBOUR_TOLERANCE)); Iterator != Index.BottomEdges.rend() && Consider(Iterator->first, Iterator->second); Iterator++) {} break; }
+    }
+    return Best;
 }
 
-WindowSegment GetWindowSegmentCursorIsIn(xcb_window_t Window) {
-    xcb_get_geometry_reply_t* WindowGeometry = xcb_get_geometry_reply(WM.Connection, xcb_get_geometry(WM.Connection, Window), NULL);
-    Coordinate CursorPosition = GetCursorPosition();
-    Coordinate AccountOffset = {};
-    AccountOffset.X = CursorPosition.X - WindowGeometry->x;
-    AccountOffset.Y = CursorPosition.Y - WindowGeometry->y;
+/* The closest monitor in a direction that overlaps the monitor across it */
+std::shared_ptr<Monitor> GetMonitorInDirection_PossibleNullptr(std::shared_ptr<Monitor> From, WindowSegment Direction) {
+    std::shared_ptr<Monitor> Best = nullptr;
+    int BestDistance = 0;
+    for (auto Monitor: WM.Monitors) {
+        if (Monitor == From) { continue; }
+        bool Overlaps; int Distance;
+        switch (Direction) {
+            case RIGHT: { Overlaps = Monitor->Y < From->Y + From->Height && From->Y < Monitor->Y + Monitor->Height; Distance = Monitor->X - (From->X + From->Width); break; }
+            case LEFT: { Overlaps = Monitor->Y < From->Y + From->Height && From->Y < Monitor->Y + Monitor->Height; Distance = From->X - (Monitor->X + Monitor->Width); break; }
+            case DOWN: { Overlaps = Monitor->X < From->X + From->Width && From->X < Monitor->X + Monitor->Width; Distance = Monitor->Y - (From->Y + From->Height); break; }
+            case UP: { Overlaps = Monitor->X < From->X + From->Width && From->X < Monitor->X + Monitor->Width; Distance = From->Y - (Monitor->Y + Monitor->Height); break; }
+        }
+        if (Overlaps && Distance >= 0 && (Best == nullptr || Distance < BestDistance)) { Best = Monitor; BestDistance = Distance; }
+    }
+    return Best;
+}
 
-    float RatioX = AccountOffset.X / WindowGeometry->width;
-    float RatioY = AccountOffset.Y / WindowGeometry->height;
+/* The container on the monitor that you'd arrive at coming in from the direction, lined up with the given span if possible */
+std::shared_ptr<Container> GetEntryContainer_PossibleNullptr(std::shared_ptr<Monitor> Target, WindowSegment Direction, int32_t SpanStart, int32_t SpanEnd) {
+    // The monitor may have padding before the first window, so search from beyond its edge
+    int32_t SearchEdge = (Direction == RIGHT || Direction == DOWN) ? INT32_MIN / 2 : INT32_MAX / 2;
+    std::shared_ptr<Container> Found = SearchSpatialIndex_PossibleNullptr(Target->Index, Direction, SearchEdge, SpanStart, SpanEnd, nullptr);
+    if (Found == nullptr) { // Nothing lines up, take anything along the edge
+        Geometry MonitorRect = {Target->X, Target->Y, static_cast<uint32_t>(Target->Width), static_cast<uint32_t>(Target->Height), 0};
+        GetPerpendicularSpan(MonitorRect, Direction, SpanStart, SpanEnd);
+        Found = SearchSpatialIndex_PossibleNullptr(Target->Index, Direction, SearchEdge, SpanStart, SpanEnd, nullptr);
+    }
+    std::cout << "Entry container for monitor " << Target->Name << " is " << Found << std::endl;
+    return Found;
+}
 
-    std::cout << "Offset Y: " << AccountOffset.Y << ", Length: " << WindowGeometry->height << std::endl;
-    std::cout << "RatioX Segment Cursor: " << RatioX << ", RatioY Segment Cursor: " << RatioY << std::endl; 
+/* Returns the index of the workspace the container belongs to, or -1 if it isn't in any workspace. Walks up to the root instead of searching every tree */
+int GetWorkspaceFromContainer(std::shared_ptr<Container> TargetContainer) {
+    std::shared_ptr<Container> Root = TargetContainer;
+    while (Root->Parent != nullptr) { Root = Root->Parent; }
 
-    if (RatioY < 0.25) { return UP; } else if (RatioY > 0.75) { return DOWN; }
-    if (RatioX < 0.5) { return LEFT; } else { return RIGHT; }
+    for (int i = 0; i < static_cast<int>(WM.Workspaces.size()); i++) {
+        if (WM.Workspaces[i]->RootContainer == Root) { return i; }
+        if (std::find(WM.Workspaces[i]->FloatingContainers.begin(), WM.Workspaces[i]->FloatingContainers.end(), TargetContainer) != WM.Workspaces[i]->FloatingContainers.end()) { return i; }
+    }
+    return -1;
 }
 
-void UpdateWindowSplitsRecursively(std::shared_ptr<Container> BaseContainer) {
+/* The windows below the base container, in left to right order */
+std::vector<std::shared_ptr<Container>> GetTiledContainersInOrder(std::shared_ptr<Container> BaseContainer) {
+    std::vector<std::shared_ptr<Container>> Containers;
+    if (BaseContainer == nullptr) { return Containers; }
     std::stack<std::shared_ptr<Container>> Stack;
     Stack.push(BaseContainer);
     while (!Stack.empty()) {
         std::shared_ptr<Container> CurrentContainer = Stack.top();
         Stack.pop();
         if (CurrentContainer->Direction == NONE) {
-            UpdateWindowToCurrentSplits(CurrentContainer);
+            Containers.push_back(CurrentContainer);
         } else {
             if (CurrentContainer->Right != nullptr) { Stack.push(CurrentContainer->Right); }
             if (CurrentContainer->Left != nullptr) { Stack.push(CurrentContainer->Left); }
-         }
+        }
     }
+    return Containers;
 }
 
-void MapWindowToWM(unsigned int WindowToMap, bool MakeFloating = false) {
-    std::shared_ptr<Window> NewWindow = std::make_shared<Window>();
-    NewWindow->Window = WindowToMap;
-    std::shared_ptr<Container> NewContainer = std::make_shared<Container>();
-    NewContainer->Direction = NONE;
-    NewContainer->Parent = nullptr;
-    NewContainer->Value = NewWindow;
-    std::shared_ptr<Workspace> ActiveWorkspace = WM.Workspaces[GetActiveWorkspaceEnsureValid(GetActiveMonitor())];
-
-    // Check if window is a popup or similar, if so map it to the center of the current monitor
-    xcb_get_property_reply_t* WindowTypeReply = xcb_get_property_reply(WM.Connection, xcb_get_property(WM.Connection, 0, WindowToMap, WM.ProtocolsContainer.NetWmWindowType, XCB_ATOM_ATOM, 0, 32), nullptr);
-    if (WindowTypeReply) {
-        if (WindowTypeReply->type == XCB_ATOM_ATOM && WindowTypeReply->format == 32 && WindowTypeReply->length > 0) {
-            xcb_atom_t* Types = (xcb_atom_t*)xcb_get_property_value(WindowTypeReply);
-            for (int i = 0; i < static_cast<int>(WindowTypeReply->length); i++) {
-                if (Types[i] == WM.ProtocolsContainer.NetWmWindowTypeDialog || Types[i] == WM.ProtocolsContainer.NetWmWindowTypeUtility || Types[i] == WM.ProtocolsContainer.NetWmWindowTypeSplash) {
-                    MakeFloating = true;
-                }
-            }
-        }
+/* The least nested window of the tree, splitting it keeps the depth of the tree logarithmic */
+std::shared_ptr<Container> GetShallowestContainer(std::shared_ptr<Container> RootContainer) {
+    std::queue<std::shared_ptr<Container>> Queue;
+    Queue.push(RootContainer);
+    while (!Queue.empty()) {
+        std::shared_ptr<Container> CurrentContainer = Queue.front();
+        Queue.pop();
+        if (CurrentContainer->Direction == NONE) { return CurrentContainer; }
+        Queue.push(CurrentContainer->Left);
+        Queue.push(CurrentContainer->Right);
     }
+    return RootContainer;
+}
 
-    if (WM.FocusedContainer != nullptr && ActiveWorkspace->RootContainer != nullptr) {
-        if (WM.FocusedContainer->Value->Floating == true) {
-            MakeFloating = true;
-        }
-    }
+/* The area of the monitor that tiled windows share, before each window takes off its own padding and borders */
+LayoutRect GetTilingArea(std::shared_ptr<Monitor> Monitor) {
+    float Padding = Runtime.Settings.MonitorPadding - (Runtime.Settings.WindowPadding/2);
+    return {Monitor->X + Padding, Monitor->Y + Padding, Monitor->Width - (Padding*2), Monitor->Height - (Padding*2)};
+}
 
-    if (MakeFloating == true) {
-        std::cout << "Window to map is floating, mapping it to 1/2 the current monitor in all respects. Window: " << WindowToMap << std::endl;
-        NewWindow->Floating = true;
-        NewWindow->Position = {0.25f, 0.25f};
-        NewWindow->Size = {0.5f, 0.5f};
-        ActiveWorkspace->FloatingContainers.push_back(NewContainer);
-        uint32_t EventMasks[] = {XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_FOCUS_CHANGE};
-        xcb_change_window_attributes(WM.Connection, WindowToMap, XCB_CW_EVENT_MASK, &EventMasks);
-        xcb_change_window_attributes(WM.Connection, WindowToMap, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveFloatingWindowBorderColour);
+/* Splits an area between the two children of a split container */
+void SplitLayoutRect(std::shared_ptr<Container> SplitContainer, const LayoutRect &Area, LayoutRect &LeftArea, LayoutRect &RightArea) {
+    LeftArea = Area; RightArea = Area;
+    if (SplitContainer->Direction == VERTICAL) {
+        LeftArea.Width = Area.Width * SplitContainer->Ratio; RightArea.X += LeftArea.Width; RightArea.Width -= LeftArea.Width;
+    } else {
+        LeftArea.Height = Area.Height * SplitContainer->Ratio; RightArea.Y += LeftArea.Height; RightArea.Height -= LeftArea.Height;
+    }
+}
 
-        int Value = 1;
-        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WindowToMap, GetAtom("FLOATING"), XCB_ATOM_CARDINAL, 32, 1, &Value);
+/* The area a container covers with the tree's splits and ratios, found by walking down from the root */
+LayoutRect GetContainerArea(std::shared_ptr<Container> TargetContainer, std::shared_ptr<Monitor> Monitor) {
+    std::stack<std::shared_ptr<Container>> Stack;
+    for (std::shared_ptr<Container> CurrentContainer = TargetContainer; CurrentContainer != nullptr; CurrentContainer = CurrentContainer->Parent) {
+        Stack.push(CurrentContainer);
+    }
 
-        UpdateWindowToCurrentSplits(NewContainer);
-        xcb_map_window(WM.Connection, WindowToMap);
-        xcb_flush(WM.Connection);
+    LayoutRect Area = GetTilingArea(Monitor);
+    while (Stack.size() > 1) { // Don't iterate over the base container
+        std::shared_ptr<Container> TopContainer = Stack.top();
+        Stack.pop();
+        LayoutRect LeftArea, RightArea;
+        SplitLayoutRect(TopContainer, Area, LeftArea, RightArea);
+        Area = (TopContainer->Right == Stack.top()) ? RightArea : LeftArea;
+    }
+    return Area;
+}
 
-        //for (auto Iterator = ActiveWorkspace->FloatingContainers.rbegin(); Iterator != ActiveWorkspace->FloatingContainers.rend(); Iterator++) {
-        for (auto Floater: ActiveWorkspace->FloatingContainers) {
-            SendWindowToFront(Floater->Value->Window);
+// ! LAYOUTS
+/* Follows the splits and ratios of the container tree, top down */
+void ArrangeTree(std::shared_ptr<Container> BaseContainer, LayoutRect Area, std::shared_ptr<Workspace> TargetWorkspace, std::vector<std::pair<std::shared_ptr<Container>, LayoutRect>> &Output) {
+    std::stack<std::pair<std::shared_ptr<Container>, LayoutRect>> Stack;
+    Stack.push({BaseContainer, Area});
+    while (!Stack.empty()) {
+        std::pair<std::shared_ptr<Container>, LayoutRect> Current = Stack.top();
+        Stack.pop();
+        if (Current.first->Direction == NONE) {
+            Output.push_back(Current);
+        } else {
+            LayoutRect LeftArea, RightArea;
+            SplitLayoutRect(Current.first, Current.second, LeftArea, RightArea);
+            Stack.push({Current.first->Right, RightArea});
+            Stack.push({Current.first->Left, LeftArea});
         }
-        return;
     }
+}
 
-    bool FullscreenRefreshNeeded = false;
+/* Rows of equal sized windows, the last row stretches its windows if it isn't full */
+void ArrangeGrid(std::shared_ptr<Container> BaseContainer, LayoutRect Area, std::shared_ptr<Workspace> TargetWorkspace, std::vector<std::pair<std::shared_ptr<Container>, LayoutRect>> &Output) {
+    std::vector<std::shared_ptr<Container>> Windows = GetTiledContainersInOrder(BaseContainer);
+    int Count = Windows.size();
+    if (Count == 0) { return; }
+    int Columns = std::ceil(std::sqrt(Count));
+    int Rows = (Count + Columns - 1) / Columns;
+    float Height = Area.Height / Rows;
+
+    for (int i = 0; i < Count; i++) {
+        int Row = i / Columns;
+        int WindowsInRow = (Row == Rows - 1) ? Count - (Row * Columns) : Columns;
+        float Width = Area.Width / WindowsInRow;
+        Output.push_back({Windows[i], {Area.X + (Width * (i % Columns)), Area.Y + (Height * Row), Width, Height}});
+    }
+}
 
-    if (ActiveWorkspace->RootContainer != nullptr) { // Need to create a split, this isn't the first window opened
-        if (WM.FocusedContainer != nullptr) { // Create window size & splits based on the focused window
+/* The first window takes MasterRatio of the width, the rest are stacked on top of each other in what remains */
+void ArrangeMasterStack(std::shared_ptr<Container> BaseContainer, LayoutRect Area, std::shared_ptr<Workspace> TargetWorkspace, std::vector<std::pair<std::shared_ptr<Container>, LayoutRect>> &Output) {
+    std::vector<std::shared_ptr<Container>> Windows = GetTiledContainersInOrder(BaseContainer);
+    int Count = Windows.size();
+    if (Count == 0) { return; }
+    if (Count == 1) { Output.push_back({Windows[0], Area}); return; }
+
+    float MasterWidth = Area.Width * TargetWorkspace->MasterRatio;
+    float StackHeight = Area.Height / (Count - 1);
+    Output.push_back({Windows[0], {Area.X, Area.Y, MasterWidth, Area.Height}});
+    for (int i = 1; i < Count; i++) {
+        Output.push_back({Windows[i], {Area.X + MasterWidth, Area.Y + (StackHeight * (i - 1)), Area.Width - MasterWidth, StackHeight}});
+    }
+}
 
-            WindowSegment Section = GetWindowSegmentCursorIsIn(WM.FocusedContainer->Value->Window);
-            std::shared_ptr<Container> NewFocusedContainer = std::make_shared<Container>();
-            NewFocusedContainer->Direction = NONE;
-            NewFocusedContainer->Value = WM.FocusedContainer->Value;
-            NewFocusedContainer->Parent = WM.FocusedContainer;
-            NewContainer->Parent = WM.FocusedContainer;
+std::unordered_map<std::string, Layout> Layouts = {
+    {"Tree", {SPLIT_FOCUSED, true, ArrangeTree}},
+    {"Balanced", {SPLIT_SHALLOWEST, true, ArrangeTree}},
+    {"Grid", {AFTER_FOCUSED, false, ArrangeGrid}},
+    {"MasterStack", {AFTER_FOCUSED, false, ArrangeMasterStack}},
+};
 
-            WM.FocusedContainer->Value = nullptr;
+const Layout &GetWorkspaceLayout(std::shared_ptr<Workspace> TargetWorkspace) {
+    auto Found = Layouts.find(TargetWorkspace->Layout);
+    if (Found == Layouts.end()) {
+        std::cerr << "No layout called " << TargetWorkspace->Layout << ", falling back to Tree" << std::endl;
+        TargetWorkspace->Layout = "Tree";
+        return Layouts.at("Tree");
+    }
+    return Found->second;
+}
 
-            if (Section == UP || Section == DOWN) {
-                WM.FocusedContainer->Direction = HORIZONTAL;
-            } else {
-                WM.FocusedContainer->Direction = VERTICAL;
-            }
+/* Builds a balanced tree out of the windows between Begin and End, splitting each area along its longer side with ratios that give every window an equal share */
+std::shared_ptr<Container> BuildBalancedTree(const std::vector<std::shared_ptr<Container>> &Windows, int Begin, int End, LayoutRect Area) {
+    if (End - Begin == 1) { return Windows[Begin]; }
+    int Middle = (Begin + End) / 2;
+    std::shared_ptr<Container> SplitContainer = std::make_shared<Container>();
+    SplitContainer->Direction = (Area.Width >= Area.Height) ? VERTICAL : HORIZONTAL;
+    SplitContainer->Ratio = static_cast<float>(Middle - Begin) / (End - Begin);
+
+    LayoutRect LeftArea, RightArea;
+    SplitLayoutRect(SplitContainer, Area, LeftArea, RightArea);
+    SplitContainer->Left = BuildBalancedTree(Windows, Begin, Middle, LeftArea);
+    SplitContainer->Right = BuildBalancedTree(Windows, Middle, End, RightArea);
+    SplitContainer->Left->Parent = SplitContainer;
+    SplitContainer->Right->Parent = SplitContainer;
+    return SplitContainer;
+}
 
-            if (Section == RIGHT || Section == DOWN) {
-                WM.FocusedContainer->Right = NewContainer;
-                WM.FocusedContainer->Left = NewFocusedContainer;
-            } else {
-                WM.FocusedContainer->Left = NewContainer;
-                WM.FocusedContainer->Right = NewFocusedContainer;
-            }
+/* Replaces the workspace tree with a balanced one holding the same windows in the same order. The window containers are kept, only the split containers are new */
+void RebalanceTree(std::shared_ptr<Workspace> TargetWorkspace, LayoutRect Area) {
+    std::vector<std::shared_ptr<Container>> Windows = GetTiledContainersInOrder(TargetWorkspace->RootContainer);
+    if (Windows.empty()) { return; }
+    TargetWorkspace->RootContainer = BuildBalancedTree(Windows, 0, Windows.size(), Area);
+    TargetWorkspace->RootContainer->Parent = nullptr;
+    std::cout << "Rebalanced tree of " << Windows.size() << " windows" << std::endl;
+}
 
-            if (ActiveWorkspace->FullscreenContainer == WM.FocusedContainer) {
-                std::cout << "Mapping window when there is a window fullscreened, changing focused container to new focused container" << std::endl;
-                ActiveWorkspace->FullscreenContainer = NewFocusedContainer;
-                FullscreenRefreshNeeded = true;
-            }
-            WM.FocusedContainer = NewFocusedContainer;
-            if (FullscreenRefreshNeeded == false) { UpdateWindowToCurrentSplits(WM.FocusedContainer); }
+/* Takes a window container out of the workspace tree, promoting its sibling into the place of their parent. Returns the promoted container, or nullptr if the container was the root */
+std::shared_ptr<Container> DetachContainerFromTree(std::shared_ptr<Container> ToBeRemoved, std::shared_ptr<Workspace> TargetWorkspace) {
+    if (ToBeRemoved->Parent == nullptr) {
+        TargetWorkspace->RootContainer = nullptr;
+        return nullptr;
+    }
+
+    std::shared_ptr<Container> PromotionContainer; // We choose the other window to be promoted
+    if (ToBeRemoved->Parent->Left == ToBeRemoved) {
+        PromotionContainer = ToBeRemoved->Parent->Right;
+    } else {
+        PromotionContainer = ToBeRemoved->Parent->Left;
+    }
 
+    if (ToBeRemoved->Parent->Parent != nullptr) { // Swapping the parent container to be the promotion container
+        if (ToBeRemoved->Parent->Parent->Left == ToBeRemoved->Parent) {
+            ToBeRemoved->Parent->Parent->Left = PromotionContainer;
         } else {
-            std::cerr << "Unable to create window as the focused window is nullptr, yet there are windows opened!" << " [EXIT] " << std::endl;
-            exit(EXIT_FAILURE);
+            ToBeRemoved->Parent->Parent->Right = PromotionContainer;
+        }
+        PromotionContainer->Parent = ToBeRemoved->Parent->Parent;
+    } else { // Do the same thing, but no need to modify the parent's parent, as the parent of promotion container is already the root container
+        TargetWorkspace->RootContainer = PromotionContainer;
+        PromotionContainer->Parent = nullptr;
+    }
+
+    ToBeRemoved->Parent = nullptr;
+    return PromotionContainer;
+}
+
+/* Puts NewContainer next to Target, by putting a new split container where Target was. Target keeps its identity, so anything pointing at it (focus, fullscreen) stays valid */
+void InsertContainerBeside(std::shared_ptr<Container> Target, std::shared_ptr<Container> NewContainer, WindowSegment Section, std::shared_ptr<Workspace> TargetWorkspace) {
+    std::shared_ptr<Container> SplitContainer = std::make_shared<Container>();
+    SplitContainer->Direction = (Section == UP || Section == DOWN) ? HORIZONTAL : VERTICAL;
+    SplitContainer->Parent = Target->Parent;
+
+    if (Target->Parent == nullptr) {
+        TargetWorkspace->RootContainer = SplitContainer;
+    } else if (Target->Parent->Left == Target) {
+        Target->Parent->Left = SplitContainer;
+    } else {
+        Target->Parent->Right = SplitContainer;
+    }
+
+    Target->Parent = SplitContainer;
+    NewContainer->Parent = SplitContainer;
+    if (Section == RIGHT || Section == DOWN) {
+        SplitContainer->Left = Target;
+        SplitContainer->Right = NewContainer;
+    } else {
+        SplitContainer->Left = NewContainer;
+        SplitContainer->Right = Target;
+    }
+}
+
+/* Takes a container out of its workspace's focus history */
+void UnlinkFocusHistory(std::shared_ptr<Container> TargetContainer, std::shared_ptr<Workspace> TargetWorkspace) {
+    if (!TargetContainer->InFocusHistory) { return; }
+    std::shared_ptr<Container> Newer = TargetContainer->FocusNewer.lock();
+    std::shared_ptr<Container> Older = TargetContainer->FocusOlder;
+    if (Newer != nullptr) { Newer->FocusOlder = Older; } else { TargetWorkspace->FocusHistory = Older; }
+    if (Older != nullptr) { Older->FocusNewer = Newer; } else { TargetWorkspace->FocusHistoryTail = Newer; }
+    TargetContainer->FocusOlder = nullptr;
+    TargetContainer->FocusNewer.reset();
+    TargetContainer->InFocusHistory = false;
+}
+
+/* Puts a container at the front of its workspace's focus history, or at the back if it hasn't been focused yet */
+void LinkFocusHistory(std::shared_ptr<Container> TargetContainer, std::shared_ptr<Workspace> TargetWorkspace, bool MostRecent) {
+    UnlinkFocusHistory(TargetContainer, TargetWorkspace);
+    if (MostRecent) {
+        TargetContainer->FocusOlder = TargetWorkspace->FocusHistory;
+        if (TargetWorkspace->FocusHistory != nullptr) { TargetWorkspace->FocusHistory->FocusNewer = TargetContainer; } else { TargetWorkspace->FocusHistoryTail = TargetContainer; }
+        TargetWorkspace->FocusHistory = TargetContainer;
+    } else {
+        std::shared_ptr<Container> Tail = TargetWorkspace->FocusHistoryTail.lock();
+        TargetContainer->FocusNewer = Tail;
+        if (Tail != nullptr) { Tail->FocusOlder = TargetContainer; } else { TargetWorkspace->FocusHistory = TargetContainer; }
+        TargetWorkspace->FocusHistoryTail = TargetContainer;
+    }
+    TargetContainer->InFocusHistory = true;
+}
+
+/* Flips a split between side by side and stacked */
+void FlipContainerSplit(std::shared_ptr<Container> SplitContainer) {
+    SplitContainer->Direction = (SplitContainer->Direction == VERTICAL) ? HORIZONTAL : VERTICAL;
+}
+
+void SwapContainerChildren(std::shared_ptr<Container> SplitContainer) {
+    std::swap(SplitContainer->Left, SplitContainer->Right);
+}
+
+/* Moves the nearest split above the window that divides it in the direction, returns that split or nullptr if there isn't one */
+std::shared_ptr<Container> ResizeContainerInDirection(std::shared_ptr<Container> TargetContainer, WindowSegment Direction) {
+    Split TargetSplit = (Direction == LEFT || Direction == RIGHT) ? VERTICAL : HORIZONTAL;
+    for (std::shared_ptr<Container> CurrentContainer = TargetContainer->Parent; CurrentContainer != nullptr; CurrentContainer = CurrentContainer->Parent) {
+        if (CurrentContainer->Direction == TargetSplit) {
+            float Change = (Direction == RIGHT || Direction == DOWN) ? RESIZE_INCREMEMNT : -RESIZE_INCREMEMNT;
+            CurrentContainer->Ratio = std::clamp(CurrentContainer->Ratio + Change, 0.05f, 0.95f);
+            return CurrentContainer;
+        }
+    }
+    return nullptr;
+}
+
+/* Checks the links and shape of the workspace's containers, describing the first problem found. Split containers must have two children and no window,
+window containers must have a window and no children, every child must point back at its parent, and no container can be reached twice */
+bool IsWorkspaceTreeValid(std::shared_ptr<Workspace> TargetWorkspace, std::string &Problem) {
+    std::unordered_set<Container*> Seen;
+    if (TargetWorkspace->RootContainer != nullptr) {
+        if (TargetWorkspace->RootContainer->Parent != nullptr) { Problem = "root container has a parent"; return false; }
+        std::stack<std::shared_ptr<Container>> Stack;
+        Stack.push(TargetWorkspace->RootContainer);
+        while (!Stack.empty()) {
+            std::shared_ptr<Container> CurrentContainer = Stack.top();
+            Stack.pop();
+            if (!Seen.insert(CurrentContainer.get()).second) { Problem = "container is in the tree twice"; return false; }
+            if (CurrentContainer->Direction == NONE) {
+                if (CurrentContainer->Value == nullptr) { Problem = "window container has no window"; return false; }
+                if (CurrentContainer->Left != nullptr || CurrentContainer->Right != nullptr) { Problem = "window container has children"; return false; }
+                if (!CurrentContainer->Tabs.empty() && std::find(CurrentContainer->Tabs.begin(), CurrentContainer->Tabs.end(), CurrentContainer->Value) == CurrentContainer->Tabs.end()) { Problem = "shown window isn't one of the container's tabs"; return false; }
+                continue;
+            }
+            if (CurrentContainer->Value != nullptr) { Problem = "split container has a window"; return false; }
+            if (CurrentContainer->Left == nullptr || CurrentContainer->Right == nullptr) { Problem = "split container is missing a child"; return false; }
+            if (CurrentContainer->Left->Parent != CurrentContainer || CurrentContainer->Right->Parent != CurrentContainer) { Problem = "child doesn't point back at its parent"; return false; }
+            if (!(CurrentContainer->Ratio > 0 && CurrentContainer->Ratio < 1)) { Problem = "split ratio is outside of 0 to 1"; return false; }
+            Stack.push(CurrentContainer->Left);
+            Stack.push(CurrentContainer->Right);
+        }
+    }
+
+    for (auto &FloatingContainer: TargetWorkspace->FloatingContainers) {
+        if (FloatingContainer->Parent != nullptr || FloatingContainer->Value == nullptr || !FloatingContainer->Value->Floating) { Problem = "floating container is malformed"; return false; }
+        if (!Seen.insert(FloatingContainer.get()).second) { Problem = "floating container is also tiled"; return false; }
+    }
+
+    size_t WindowContainers = GetTiledContainersInOrder(TargetWorkspace->RootContainer).size() + TargetWorkspace->FloatingContainers.size();
+    size_t Linked = 0;
+    std::shared_ptr<Container> Newer = nullptr;
+    for (std::shared_ptr<Container> CurrentContainer = TargetWorkspace->FocusHistory; CurrentContainer != nullptr; CurrentContainer = CurrentContainer->FocusOlder) {
+        if (++Linked > WindowContainers) { Problem = "focus history is longer than the workspace or loops"; return false; }
+        if (Seen.count(CurrentContainer.get()) == 0 || CurrentContainer->Direction != NONE) { Problem = "focus history has a container that isn't a window of the workspace"; return false; }
+        if (!CurrentContainer->InFocusHistory || CurrentContainer->FocusNewer.lock() != Newer) { Problem = "focus history doesn't link back"; return false; }
+        Newer = CurrentContainer;
+    }
+    if (Linked != WindowContainers) { Problem = "focus history is missing a window"; return false; }
+    if (TargetWorkspace->FocusHistoryTail.lock() != Newer) { Problem = "focus history tail isn't the last container"; return false; }
+    return true;
+}
+
+// ! GEOMETRY
+void QueueTiledGeometry(std::shared_ptr<Container> TargetContainer, LayoutRect Area, std::shared_ptr<Monitor> Monitor) {
+    float BorderWidth = Runtime.Settings.TiledWindowBorderSize;
+    float X = Area.X + (Runtime.Settings.WindowPadding/2);
+    float Y = Area.Y + (Runtime.Settings.WindowPadding/2);
+    float Width = std::max(1.0f, Area.Width - Runtime.Settings.WindowPadding - (2*BorderWidth));
+    float Height = std::max(1.0f, Area.Height - Runtime.Settings.WindowPadding - (2*BorderWidth));
+
+    Geometry Target = {static_cast<int32_t>(X), static_cast<int32_t>(Y), static_cast<uint32_t>(Width), static_cast<uint32_t>(Height), static_cast<uint32_t>(BorderWidth)};
+    ApplySizeHints(TargetContainer->Value->Hints, Target.Width, Target.Height);
+    Target.X += (static_cast<int32_t>(Width) - static_cast<int32_t>(Target.Width)) / 2; // Centred in its tile if the hints changed its size
+    Target.Y += (static_cast<int32_t>(Height) - static_cast<int32_t>(Target.Height)) / 2;
+    QueueWindowGeometry(TargetContainer->Value, Target, Monitor->RefreshRate, DraggedWindow != TargetContainer);
+    TargetContainer->Value->Offscreen = false;
+    IndexContainer(TargetContainer, Monitor, {static_cast<int32_t>(Area.X), static_cast<int32_t>(Area.Y), static_cast<uint32_t>(std::max(0.0f, Area.Width)), static_cast<uint32_t>(std::max(0.0f, Area.Height)), 0});
+    std::cout << "Queued Window " << TargetContainer->Value->Window << " to current splits, PosX: " << X << ", PosY: " << Y << ", Width: " << Width << ", Height: " << Height << std::endl;
+}
+
+/* Hides the window below the bottom of the screen. Windows that are already hidden are left alone, their layout waits until their workspace is shown again */
+void MoveWindowOffscreen(std::shared_ptr<Container> TargetContainer) {
+    UnindexContainer(TargetContainer);
+    std::shared_ptr<Window> TargetWindow = TargetContainer->Value;
+    if (TargetWindow->Offscreen) { return; }
+
+    std::cout << "Monitor is nullptr, and so is offscreen" << std::endl;
+    Geometry Offscreen = GetWindowGeometry(TargetWindow); // Committed geometry, so this normally costs no round trip
+    Offscreen.Y += WM.Screen->height_in_pixels * OFFSCREEN_WINDOW_MULTIPLIER;
+    QueueWindowGeometry(TargetWindow, Offscreen, DEFAULT_REFRESH_RATE, false);
+    TargetWindow->Offscreen = true;
+}
+
+void QueueFullscreenGeometry(std::shared_ptr<Container> TargetContainer, std::shared_ptr<Monitor> Monitor) {
+    std::cout << "Setting fullscreened window to max res" << std::endl;
+    UnindexContainer(TargetContainer); // Covers everything, so has no neighbours
+    QueueWindowGeometry(TargetContainer->Value, {Monitor->X, Monitor->Y, static_cast<uint32_t>(Monitor->Width), static_cast<uint32_t>(Monitor->Height), 0}, Monitor->RefreshRate, true);
+    TargetContainer->Value->Offscreen = false;
+}
+
+/* Lays out the tiled windows from the base container down with the workspace's layout. Layouts that don't follow the tree always lay out the whole workspace */
+void ArrangeContainers(std::shared_ptr<Container> BaseContainer, std::shared_ptr<Workspace> TargetWorkspace, std::shared_ptr<Monitor> Monitor) {
+    TraceScope Scope("ArrangeContainers", "layout");
+    const Layout &WorkspaceLayout = GetWorkspaceLayout(TargetWorkspace);
+    LayoutRect Area;
+    if (WorkspaceLayout.FollowsTree) {
+        Area = GetContainerArea(BaseContainer, Monitor);
+    } else {
+        BaseContainer = TargetWorkspace->RootContainer;
+        Area = GetTilingArea(Monitor);
+    }
+    if (BaseContainer == nullptr) { return; }
+
+    if (TargetWorkspace->FullscreenContainer != nullptr) { // Layout is suspended, the windows underneath are laid out when the fullscreen window leaves
+        if (TargetWorkspace->FullscreenContainer->Value->Floating == false) { QueueFullscreenGeometry(TargetWorkspace->FullscreenContainer, Monitor); }
+        TargetWorkspace->LayoutDirty = true;
+        return;
+    }
+
+    std::vector<std::pair<std::shared_ptr<Container>, LayoutRect>> Output;
+    WorkspaceLayout.Arrange(BaseContainer, Area, TargetWorkspace, Output);
+    for (auto &Pair: Output) {
+        QueueTiledGeometry(Pair.first, Pair.second, Monitor);
+    }
+    std::cout << "Arranged " << Output.size() << " windows with the " << TargetWorkspace->Layout << " layout" << std::endl;
+}
+
+void UpdateWindowToCurrentSplits(std::shared_ptr<Container> TargetContainer, std::shared_ptr<Monitor> Monitor = nullptr) {
+    if (TargetContainer->Value == nullptr) {
+        std::cerr << "Target container has no value -- cannot proceed in positioning and sizing it! [EXIT]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Updating to current splits: " << TargetContainer->Parent << " " << TargetContainer->Left << " " << TargetContainer->Right << " " << TargetContainer->Value->Window << std::endl;
+
+    if (Monitor == nullptr) { // No monitor has been supplied, we have to calculate
+        Monitor = GetMonitorFromWorkspace_PossibleNullptr(GetWorkspaceFromContainer(TargetContainer));
+    }
+
+    if (Monitor == nullptr) { // Workspace is off screen
+        int WorkspaceIndex = GetWorkspaceFromContainer(TargetContainer);
+        if (WorkspaceIndex != -1) { WM.Workspaces[WorkspaceIndex]->LayoutDirty = true; }
+        MoveWindowOffscreen(TargetContainer);
+        return;
+    }
+
+    std::shared_ptr<Workspace> TargetWorkspace = WM.Workspaces[GetActiveWorkspaceEnsureValid(Monitor)];
+    if (TargetContainer == TargetWorkspace->FullscreenContainer) {
+        QueueFullscreenGeometry(TargetContainer, Monitor);
+    } else if (TargetWorkspace->FullscreenContainer != nullptr) { // Covered, so configuring it would only cost the fullscreen window frames
+        std::cout << "Window " << TargetContainer->Value->Window << " is covered by a fullscreen window, skipping its geometry" << std::endl;
+        TargetWorkspace->LayoutDirty = true;
+    } else if (TargetContainer->Value->Floating == true) {
+        UnindexContainer(TargetContainer);
+        float BorderWidth = Runtime.Settings.FloatingWindowBorderSize;
+        float X = Monitor->X + (Monitor->Width * TargetContainer->Value->Position.X);
+        float Y = Monitor->Y + (Monitor->Height * TargetContainer->Value->Position.Y);
+        float Width = std::max(1.0f, (Monitor->Width * TargetContainer->Value->Size.X) - (2*BorderWidth));
+        float Height = std::max(1.0f, (Monitor->Height * TargetContainer->Value->Size.Y) - (2*BorderWidth));
+        Geometry Target = {static_cast<int32_t>(X), static_cast<int32_t>(Y), static_cast<uint32_t>(Width), static_cast<uint32_t>(Height), static_cast<uint32_t>(BorderWidth)};
+        ApplySizeHints(TargetContainer->Value->Hints, Target.Width, Target.Height); // Keeps its top left corner where it was put
+        QueueWindowGeometry(TargetContainer->Value, Target, Monitor->RefreshRate, DraggedWindow != TargetContainer);
+        TargetContainer->Value->Offscreen = false;
+        std::cout << "Queued Window " << TargetContainer->Value->Window << " to current splits, PosX: " << X << ", PosY: " << Y << ", Width: " << Width << ", Height: " << Height << std::endl;
+    } else if (GetWorkspaceLayout(TargetWorkspace).FollowsTree) {
+        QueueTiledGeometry(TargetContainer, GetContainerArea(TargetContainer, Monitor), Monitor);
+    } else { // The layout needs every window to place any of them
+        ArrangeContainers(TargetWorkspace->RootContainer, TargetWorkspace, Monitor);
+    }
+}
+
+WindowSegment GetWindowSegmentCursorIsIn(std::shared_ptr<Window> TargetWindow) {
+    Geometry WindowGeometry = GetWindowGeometry(TargetWindow);
+    Coordinate CursorPosition = GetCursorPosition();
+    Coordinate AccountOffset = {};
+    AccountOffset.X = CursorPosition.X - WindowGeometry.X;
+    AccountOffset.Y = CursorPosition.Y - WindowGeometry.Y;
+
+    float RatioX = AccountOffset.X / std::max(1u, WindowGeometry.Width);
+    float RatioY = AccountOffset.Y / std::max(1u, WindowGeometry.Height);
+
+    std::cout << "Offset Y: " << AccountOffset.Y << ", Length: " << WindowGeometry.Height << std::endl;
+    std::cout << "RatioX Segment Cursor: " << RatioX << ", RatioY Segment Cursor: " << RatioY << std::endl; 
+
+    if (RatioY < 0.25) { return UP; } else if (RatioY > 0.75) { return DOWN; }
+    if (RatioX < 0.5) { return LEFT; } else { return RIGHT; }
+}
+
+void UpdateWindowSplitsRecursively(std::shared_ptr<Container> BaseContainer) {
+    int WorkspaceIndex = GetWorkspaceFromContainer(BaseContainer);
+    if (WorkspaceIndex == -1) {
+        std::cerr << "Could not find the workspace of container " << BaseContainer << ", cannot update its splits" << std::endl;
+        return;
+    }
+
+    std::shared_ptr<Monitor> Monitor = GetMonitorFromWorkspace_PossibleNullptr(WorkspaceIndex);
+    if (Monitor == nullptr) { // Workspace is off screen, it gets laid out when it's shown
+        WM.Workspaces[WorkspaceIndex]->LayoutDirty = true;
+        for (auto CurrentContainer: GetTiledContainersInOrder(BaseContainer)) {
+            MoveWindowOffscreen(CurrentContainer);
+        }
+        return;
+    }
+    ArrangeContainers(BaseContainer, WM.Workspaces[WorkspaceIndex], Monitor);
+}
+
+/* Lays out every window of the workspace, tiled and floating. Skipped if the workspace is already laid out on the monitor it's on and nothing has changed since */
+void UpdateWorkspaceSplits(unsigned int WorkspaceIndex) {
+    TraceScope Scope("UpdateWorkspaceSplits", "layout");
+    std::shared_ptr<Workspace> TargetWorkspace = WM.Workspaces[WorkspaceIndex];
+    std::shared_ptr<Monitor> Monitor = GetMonitorFromWorkspace_PossibleNullptr(WorkspaceIndex);
+    if (Monitor != nullptr && Monitor == TargetWorkspace->LaidOutOn && !TargetWorkspace->LayoutDirty) {
+        std::cout << "Workspace " << WorkspaceIndex << " is already laid out, skipping it" << std::endl;
+        return;
+    }
+    TargetWorkspace->LayoutDirty = false; // Laying out can mark it again, if a fullscreen window covers the rest
+    TargetWorkspace->LaidOutOn = Monitor;
+
+    if (TargetWorkspace->RootContainer != nullptr) {
+        UpdateWindowSplitsRecursively(TargetWorkspace->RootContainer);
+    }
+    for (auto FloatingContainer: TargetWorkspace->FloatingContainers) {
+        UpdateWindowToCurrentSplits(FloatingContainer);
+    }
+}
+
+void EnsureValidWorkspacesBetweenIndicesInclusive(int LowerBound, int UpperBound) {
+    for (int i = LowerBound; i <= UpperBound; i++) {
+        if (static_cast<int>(WM.Workspaces.size()-1) < i) { // Current Index doesn't exist -- create a new one
+            std::shared_ptr<Workspace> NewWorkspace = std::make_shared<Workspace>();
+            WM.Workspaces.push_back(NewWorkspace);
+            std::cout << "Created Workspace at Index " << i << ", ensuring a valid range" << std::endl;
+        }
+    }
+}
+
+// ! SUBSCRIPTIONS
+/* Classes of changes a subscriber can ask for */
+enum SubscriptionClass {
+    SUBSCRIBE_FOCUS = 1,
+    SUBSCRIBE_WORKSPACE = 2,
+    SUBSCRIBE_WINDOW = 4,
+    SUBSCRIBE_LAYOUT = 8,
+    SUBSCRIBE_MONITOR = 16,
+};
+
+/* A client of the subscription socket. Messages wait in a bounded queue that drops the oldest if the client doesn't keep up, so it can never block the WM */
+struct Subscriber {
+    int Socket;
+    uint32_t Classes = 0; // Nothing is sent until it subscribes
+    bool NeedsSnapshot = false; // Just subscribed, so it's sent the current state instead of what changed
+    bool Gone = false;
+    std::string Input; // Partial line read from the client
+    std::deque<std::string> Queue;
+    size_t Written = 0; // Bytes of the front message already sent
+    uint64_t Dropped = 0;
+};
+
+/* What subscribers were last told, so each iteration of the event loop only sends what changed */
+struct SubscriptionState {
+    xcb_window_t Focus = XCB_NONE;
+    int FocusWorkspace = -1;
+    std::vector<int> Workspaces; // Active workspace of each monitor, in the order of WM.Monitors
+    std::string Monitor; // Monitor the cursor is on
+    std::vector<std::pair<std::string, xcb_window_t>> Layouts; // Layout and fullscreen window of each workspace
+};
+
+static int SubscriptionSocket = -1;
+static std::vector<std::shared_ptr<Subscriber>> Subscribers;
+static std::vector<std::pair<uint32_t, std::string>> PendingMessages; // Window events from this iteration of the event loop, sent at the end of it
+static SubscriptionState Notified;
+
+std::string JsonString(const std::string &Value) {
+    std::string Result = "\"";
+    for (char Character: Value) {
+        if (Character == '"' || Character == '\\') { Result += '\\'; }
+        if (static_cast<unsigned char>(Character) < 0x20) { continue; }
+        Result += Character;
+    }
+    return Result + "\"";
+}
+
+/* Windows coming and going are events rather than state, so they're recorded as they happen */
+void NotifyWindowChange(xcb_window_t Window, const char* Change, int Workspace) {
+    if (Subscribers.empty()) { return; }
+    PendingMessages.push_back({SUBSCRIBE_WINDOW, "{\"event\":\"window\",\"change\":\"" + std::string(Change) + "\",\"window\":" + std::to_string(Window) + ",\"workspace\":" + std::to_string(Workspace) + "}"});
+}
+
+std::string GetFocusMessage() {
+    return "{\"event\":\"focus\",\"window\":" + std::to_string(Notified.Focus) + ",\"workspace\":" + std::to_string(Notified.FocusWorkspace) + "}";
+}
+
+std::string GetWorkspaceMessage() {
+    std::string Message = "{\"event\":\"workspace\",\"monitors\":[";
+    for (size_t i = 0; i < Notified.Workspaces.size() && i < WM.Monitors.size(); i++) {
+        Message += std::string((i == 0) ? "" : ",") + "{\"monitor\":" + JsonString(WM.Monitors[i]->Name) + ",\"workspace\":" + std::to_string(Notified.Workspaces[i]) + "}";
+    }
+    return Message + "]}";
+}
+
+std::string GetMonitorMessage() {
+    return "{\"event\":\"monitor\",\"monitor\":" + JsonString(Notified.Monitor) + "}";
+}
+
+std::string GetLayoutMessage(size_t Workspace) {
+    return "{\"event\":\"layout\",\"workspace\":" + std::to_string(Workspace) + ",\"layout\":" + JsonString(Notified.Layouts[Workspace].first) + ",\"fullscreen\":" + std::to_string(Notified.Layouts[Workspace].second) + "}";
+}
+
+void QueueForSubscriber(Subscriber &Target, const std::string &Message) {
+    if (Target.Queue.size() >= SUBSCRIBER_QUEUE_LENGTH) {
+        Target.Queue.erase(Target.Queue.begin() + ((Target.Written > 0) ? 1 : 0)); // The front can be half sent, dropping it would cut a line in two
+        if (Target.Dropped++ == 0) { std::cerr << "Subscriber " << Target.Socket << " isn't keeping up, dropping its oldest messages" << std::endl; }
+    }
+    Target.Queue.push_back(Message + "\n");
+}
+
+/* Sends as much of the queue as the socket takes without blocking */
+void FlushSubscriber(Subscriber &Target) {
+    while (!Target.Queue.empty()) {
+        const std::string &Front = Target.Queue.front();
+        ssize_t Sent = send(Target.Socket, Front.data() + Target.Written, Front.size() - Target.Written, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (Sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) { Target.Gone = true; }
+            return;
+        }
+        Target.Written += Sent;
+        if (Target.Written < Front.size()) { return; }
+        Target.Queue.pop_front();
+        Target.Written = 0;
+    }
+}
+
+/* A subscriber sends the classes it wants on a line, eg. "focus workspace window" or ["layout","monitor"], and each line replaces the last */
+void ReadSubscriber(Subscriber &Target) {
+    char Buffer[512];
+    while (true) {
+        ssize_t Read = recv(Target.Socket, Buffer, sizeof(Buffer), MSG_DONTWAIT);
+        if (Read == 0 || (Read < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) { Target.Gone = true; return; }
+        if (Read < 0) { return; }
+        Target.Input.append(Buffer, Read);
+
+        size_t End;
+        while ((End = Target.Input.find('\n')) != std::string::npos) {
+            std::string Line = Target.Input.substr(0, End);
+            Target.Input.erase(0, End + 1);
+            std::replace_if(Line.begin(), Line.end(), [](char Character) { return Character == '[' || Character == ']' || Character == '"' || Character == ','; }, ' ');
+
+            const std::unordered_map<std::string, uint32_t> Names = {{"focus", SUBSCRIBE_FOCUS}, {"workspace", SUBSCRIBE_WORKSPACE}, {"window", SUBSCRIBE_WINDOW}, {"layout", SUBSCRIBE_LAYOUT}, {"monitor", SUBSCRIBE_MONITOR}, {"all", UINT32_MAX}};
+            std::istringstream Words(Line);
+            std::string Word;
+            Target.Classes = 0;
+            while (Words >> Word) {
+                auto Found = Names.find(Word);
+                if (Found != Names.end()) { Target.Classes |= Found->second; } else { std::cerr << "Subscriber " << Target.Socket << " asked for an unknown class: " << Word << std::endl; }
+            }
+            Target.NeedsSnapshot = true;
+            std::cout << "Subscriber " << Target.Socket << " subscribed to: " << Line << std::endl;
+        }
+        if (Target.Input.size() > 4096) { Target.Gone = true; return; } // Not speaking the protocol
+    }
+}
+
+void AcceptSubscribers() {
+    int Socket;
+    while ((Socket = accept4(SubscriptionSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        std::shared_ptr<Subscriber> NewSubscriber = std::make_shared<Subscriber>();
+        NewSubscriber->Socket = Socket;
+        Subscribers.push_back(NewSubscriber);
+        std::cout << "Accepted subscriber " << Socket << std::endl;
+    }
+}
+
+void RemoveGoneSubscribers() {
+    for (auto &Target: Subscribers) {
+        if (Target->Gone) {
+            close(Target->Socket);
+            std::cout << "Subscriber " << Target->Socket << " went away" << std::endl;
+        }
+    }
+    Subscribers.erase(std::remove_if(Subscribers.begin(), Subscribers.end(), [](const std::shared_ptr<Subscriber> &Target) { return Target->Gone; }), Subscribers.end());
+}
+
+/* Compares what subscribers care about against what they were last told, and queues the changes along with this iteration's window events.
+New subscribers get the whole state instead, so they never have to ask the X server for it */
+void PublishSubscriptions() {
+    if (Subscribers.empty()) {
+        PendingMessages.clear();
+        return;
+    }
+    TraceScope Scope("PublishSubscriptions", "layout");
+
+    xcb_window_t Focus = (WM.FocusedContainer != nullptr) ? WM.FocusedContainer->Value->Window : XCB_NONE;
+    if (Focus != Notified.Focus) {
+        Notified.Focus = Focus;
+        Notified.FocusWorkspace = (WM.FocusedContainer != nullptr) ? GetWorkspaceFromContainer(WM.FocusedContainer) : -1;
+        PendingMessages.push_back({SUBSCRIBE_FOCUS, GetFocusMessage()});
+    }
+
+    std::vector<int> Workspaces;
+    for (auto &Monitor: WM.Monitors) { Workspaces.push_back(Monitor->ActiveWorkspace); }
+    if (Workspaces != Notified.Workspaces) {
+        Notified.Workspaces = Workspaces;
+        PendingMessages.push_back({SUBSCRIBE_WORKSPACE, GetWorkspaceMessage()});
+    }
+
+    std::string Monitor = (WM.Cursor.CurrentMonitor != nullptr) ? WM.Cursor.CurrentMonitor->Name : "";
+    if (Monitor != Notified.Monitor) {
+        Notified.Monitor = Monitor;
+        PendingMessages.push_back({SUBSCRIBE_MONITOR, GetMonitorMessage()});
+    }
+
+    Notified.Layouts.resize(WM.Workspaces.size());
+    for (size_t i = 0; i < WM.Workspaces.size(); i++) {
+        std::pair<std::string, xcb_window_t> Layout = {WM.Workspaces[i]->Layout, (WM.Workspaces[i]->FullscreenContainer != nullptr) ? WM.Workspaces[i]->FullscreenContainer->Value->Window : XCB_NONE};
+        if (Layout != Notified.Layouts[i]) {
+            Notified.Layouts[i] = Layout;
+            PendingMessages.push_back({SUBSCRIBE_LAYOUT, GetLayoutMessage(i)});
+        }
+    }
+
+    for (auto &Target: Subscribers) {
+        if (Target->NeedsSnapshot) {
+            Target->NeedsSnapshot = false;
+            if (Target->Classes & SUBSCRIBE_FOCUS) { QueueForSubscriber(*Target, GetFocusMessage()); }
+            if (Target->Classes & SUBSCRIBE_WORKSPACE) { QueueForSubscriber(*Target, GetWorkspaceMessage()); }
+            if (Target->Classes & SUBSCRIBE_MONITOR) { QueueForSubscriber(*Target, GetMonitorMessage()); }
+            if (Target->Classes & SUBSCRIBE_LAYOUT) { for (size_t i = 0; i < Notified.Layouts.size(); i++) { QueueForSubscriber(*Target, GetLayoutMessage(i)); } }
+        } else {
+            for (auto &Message: PendingMessages) {
+                if (Target->Classes & Message.first) { QueueForSubscriber(*Target, Message.second); }
+            }
+        }
+        FlushSubscriber(*Target);
+    }
+    PendingMessages.clear();
+    RemoveGoneSubscribers();
+}
+
+/* Listens on $EXERT_SOCKET, or $XDG_RUNTIME_DIR/exert.sock if it isn't set, and exports the path so scripts started by the WM can find it */
+void InitialiseSubscriptions() {
+    std::string Path;
+    if (getenv("EXERT_SOCKET")) {
+        Path = getenv("EXERT_SOCKET");
+    } else if (getenv("XDG_RUNTIME_DIR")) {
+        Path = std::string(getenv("XDG_RUNTIME_DIR")) + "/exert.sock";
+    } else { // /tmp is shared with every user, so the socket goes in a directory only we can get into
+        std::string Directory = "/tmp/exert-" + std::to_string(getuid());
+        struct stat Existing;
+        if (mkdir(Directory.c_str(), 0700) != 0 && errno != EEXIST) {
+            std::cerr << "Failed to create " << Directory << " for the subscription socket: " << strerror(errno) << std::endl;
+            return;
+        }
+        if (lstat(Directory.c_str(), &Existing) != 0 || !S_ISDIR(Existing.st_mode) || Existing.st_uid != getuid() || (Existing.st_mode & 077) != 0) {
+            std::cerr << Directory << " isn't a directory that only we can use, not listening for subscribers" << std::endl;
+            return;
+        }
+        Path = Directory + "/exert.sock";
+    }
+
+    sockaddr_un Address = {};
+    Address.sun_family = AF_UNIX;
+    if (Path.size() >= sizeof(Address.sun_path)) {
+        std::cerr << "Subscription socket path is too long: " << Path << std::endl;
+        return;
+    }
+    strcpy(Address.sun_path, Path.c_str());
+
+    // Another instance may still be listening on it, only a socket that refuses connections was left behind by an earlier run
+    int Probe = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    bool Listening = (Probe >= 0 && (connect(Probe, (sockaddr*)&Address, sizeof(Address)) == 0 || errno == EAGAIN)); // EAGAIN is a full backlog, someone is still there
+    int ProbeError = errno;
+    if (Probe >= 0) { close(Probe); }
+    if (Listening) {
+        std::cerr << "Something is already listening on the subscription socket " << Path << ", not taking it over" << std::endl;
+        return;
+    }
+    struct stat Existing;
+    if (ProbeError == ECONNREFUSED && lstat(Path.c_str(), &Existing) == 0 && S_ISSOCK(Existing.st_mode)) { unlink(Path.c_str()); }
+
+    SubscriptionSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (SubscriptionSocket < 0 || bind(SubscriptionSocket, (sockaddr*)&Address, sizeof(Address)) != 0 || listen(SubscriptionSocket, 8) != 0) {
+        std::cerr << "Failed to listen on the subscription socket " << Path << ": " << strerror(errno) << std::endl;
+        if (SubscriptionSocket >= 0) { close(SubscriptionSocket); }
+        SubscriptionSocket = -1;
+        return;
+    }
+    setenv("EXERT_SOCKET", Path.c_str(), 1);
+    std::cout << "Listening for subscribers on " << Path << std::endl;
+}
+
+// ! TABS
+/* Unmaps a tab that's being switched away from, so the client can stop drawing it, and marks it hidden so it doesn't look withdrawn */
+void HideTab(std::shared_ptr<Window> Tab) {
+    PendingCommits.erase(Tab->Window); // It takes the shown tab's geometry when it comes back
+    Tab->HasCommittedGeometry = false; // So that geometry is applied as it's mapped, not animated from where it used to be
+    Tab->IgnoreUnmaps++;
+    DropWindowOnError(xcb_unmap_window(WM.Connection, Tab->Window), Tab->Window);
+    xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, Tab->Window, WM.ProtocolsContainer.NetWmState, XCB_ATOM_ATOM, 32, 1, &WM.ProtocolsContainer.NetWmStateHidden);
+}
+
+/* Shows Tab in place of the window the container is showing. It takes over that window's rectangle, so nothing else in the tree is laid out again */
+void SelectTab(std::shared_ptr<Container> TabbedContainer, std::shared_ptr<Window> Tab) {
+    TraceScope Scope("SelectTab", "layout");
+    std::shared_ptr<Window> Previous = TabbedContainer->Value;
+    if (Previous == Tab) { return; }
+
+    auto Pending = PendingCommits.find(Previous->Window);
+    bool HasGeometry = (Pending != PendingCommits.end() || Previous->HasCommittedGeometry);
+    Geometry Target = (Pending != PendingCommits.end()) ? Pending->second.To : Previous->CommittedGeometry;
+    bool Offscreen = Previous->Offscreen;
+    if (std::find(TabbedContainer->Tabs.begin(), TabbedContainer->Tabs.end(), Previous) != TabbedContainer->Tabs.end()) { HideTab(Previous); } // Otherwise it was just removed
+    TabbedContainer->Value = Tab;
+
+    int WorkspaceIndex = GetWorkspaceFromContainer(TabbedContainer);
+    if (WorkspaceIndex != -1 && WM.Workspaces[WorkspaceIndex]->FullscreenContainer == TabbedContainer) {
+        SetWindowFullscreenHints(Tab->Window, true);
+    } else {
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, Tab->Window, WM.ProtocolsContainer.NetWmState, XCB_ATOM_ATOM, 32, 0, nullptr);
+    }
+
+    if (HasGeometry && !Tab->Hints.Set && !Previous->Hints.Set) { // Otherwise the rectangle depends on whose size hints it was fitted to
+        QueueWindowGeometry(Tab, Target, DEFAULT_REFRESH_RATE, false);
+        Tab->Offscreen = Offscreen;
+    } else {
+        UpdateWindowToCurrentSplits(TabbedContainer);
+    }
+    xcb_change_window_attributes(WM.Connection, Tab->Window, XCB_CW_BORDER_PIXEL, (WM.FocusedContainer == TabbedContainer) ? &Runtime.Settings.ActiveTiledWindowBorderColour : &Runtime.Settings.InActiveTiledWindowBorderColour);
+    CommitWindowGeometryNow(Tab); // CommitPendingGeometry could hold it back for pacing or a sync request, and the tab would be mapped at its old geometry
+    DropWindowOnError(xcb_map_window(WM.Connection, Tab->Window), Tab->Window);
+    if (WM.FocusedContainer == TabbedContainer) { // Focus stays with the container
+        DropWindowOnError(xcb_set_input_focus(WM.Connection, XCB_INPUT_FOCUS_POINTER_ROOT, Tab->Window, XCB_CURRENT_TIME), Tab->Window);
+    }
+    if (WorkspaceIndex != -1) { RestackWorkspace(WM.Workspaces[WorkspaceIndex]); }
+    FlushConnection();
+    std::cout << "Showing tab " << Tab->Window << " in place of " << Previous->Window << std::endl;
+}
+
+/* Takes a window out of a tabbed container that has other tabs, the next tab is shown if it was the one being shown */
+void RemoveTab(std::shared_ptr<Container> TabbedContainer, xcb_window_t TabWindow, int Workspace) {
+    auto Found = std::find_if(TabbedContainer->Tabs.begin(), TabbedContainer->Tabs.end(), [&](const std::shared_ptr<Window> &Tab) { return Tab->Window == TabWindow; });
+    if (Found == TabbedContainer->Tabs.end()) { return; }
+
+    std::shared_ptr<Window> Removed = *Found;
+    size_t Index = Found - TabbedContainer->Tabs.begin();
+    TabbedContainer->Tabs.erase(Found);
+    DestroySyncAlarm(Removed);
+    WM.Workspaces[Workspace]->ClientsChanged = true;
+    NotifyWindowChange(TabWindow, "removed", Workspace);
+    std::cout << "Removed tab " << TabWindow << ", " << TabbedContainer->Tabs.size() << " left" << std::endl;
+
+    if (TabbedContainer->Value == Removed) { SelectTab(TabbedContainer, TabbedContainer->Tabs[std::min(Index, TabbedContainer->Tabs.size() - 1)]); }
+    PendingCommits.erase(TabWindow); // After SelectTab, which takes over its pending geometry
+}
+
+// ! WINDOW RULES
+/* Builds the lookup tables for the config's rules, only done once as they never change while running */
+void CompileWindowRules() {
+    for (int i = 0; i < static_cast<int>(Runtime.Rules.size()); i++) {
+        const WindowRule &Rule = Runtime.Rules[i];
+        WindowRules.WindowTypes.push_back(Rule.WindowType.empty() ? XCB_NONE : GetAtom(Rule.WindowType));
+        if (!Rule.Class.empty()) {
+            WindowRules.ByClass[Rule.Class].push_back(i);
+        } else if (!Rule.Instance.empty()) {
+            WindowRules.ByInstance[Rule.Instance].push_back(i);
+        } else if (!Rule.Title.empty()) {
+            WindowRules.ByTitle[Rule.Title].push_back(i);
+        } else if (!Rule.WindowType.empty()) {
+            WindowRules.ByWindowType[WindowRules.WindowTypes[i]].push_back(i);
+        } else {
+            WindowRules.MatchAll.push_back(i);
+        }
+    }
+    std::cout << "Compiled " << Runtime.Rules.size() << " window rules" << std::endl;
+}
+
+/* Finds the rules that match the window and merges what they decide, in config order */
+RuleOutcome MatchWindowRules(const std::string &Class, const std::string &Instance, const std::string &Title, const std::vector<xcb_atom_t> &Types) {
+    std::vector<int> Candidates = WindowRules.MatchAll;
+    auto AddCandidates = [&](const auto &Table, const auto &Key) {
+        auto Found = Table.find(Key);
+        if (Found != Table.end()) { Candidates.insert(Candidates.end(), Found->second.begin(), Found->second.end()); }
+    };
+    AddCandidates(WindowRules.ByClass, Class);
+    AddCandidates(WindowRules.ByInstance, Instance);
+    AddCandidates(WindowRules.ByTitle, Title);
+    for (xcb_atom_t Type: Types) { AddCandidates(WindowRules.ByWindowType, Type); }
+    std::sort(Candidates.begin(), Candidates.end());
+
+    RuleOutcome Outcome;
+    for (int i: Candidates) { // Each rule was only indexed by one field, so the others still have to be checked
+        const WindowRule &Rule = Runtime.Rules[i];
+        if (!Rule.Class.empty() && Rule.Class != Class) { continue; }
+        if (!Rule.Instance.empty() && Rule.Instance != Instance) { continue; }
+        if (!Rule.Title.empty() && Rule.Title != Title) { continue; }
+        if (WindowRules.WindowTypes[i] != XCB_NONE && std::find(Types.begin(), Types.end(), WindowRules.WindowTypes[i]) == Types.end()) { continue; }
+
+        std::cout << "Window rule " << i << " matched" << std::endl;
+        if (Rule.Workspace != -1) { Outcome.Workspace = Rule.Workspace; }
+        if (Rule.Floating != -1) { Outcome.Floating = Rule.Floating; }
+        if (Rule.Width > 0) { Outcome.Size.X = std::min(Rule.Width, 1.0f); }
+        if (Rule.Height > 0) { Outcome.Size.Y = std::min(Rule.Height, 1.0f); }
+    }
+    return Outcome;
+}
+
+std::string GetPropertyString(xcb_get_property_reply_t* Reply) {
+    if (Reply == nullptr || Reply->format != 8) { return ""; }
+    return std::string((const char*)xcb_get_property_value(Reply), xcb_get_property_value_length(Reply));
+}
+
+// ! THROTTLING
+/* A process we throttled because all of its windows were on hidden workspaces */
+struct ThrottledProcess {
+    std::string Policy; // So it's undone the same way
+    std::string PreviousCGroup; // Only for "CGroup", the directory it's moved back into
+    uint64_t StartTime = 0; // So a process that reused the pid after this one exited is never resumed in its place
+};
+
+static std::unordered_map<pid_t, ThrottledProcess> ThrottledProcesses;
+
+/* Every window of a workspace, including hidden tabs */
+std::vector<std::shared_ptr<Window>> GetWorkspaceWindows(std::shared_ptr<Workspace> TargetWorkspace) {
+    std::vector<std::shared_ptr<Window>> Windows;
+    for (auto &TiledContainer: GetTiledContainersInOrder(TargetWorkspace->RootContainer)) {
+        if (TiledContainer->Tabs.empty()) { Windows.push_back(TiledContainer->Value); }
+        Windows.insert(Windows.end(), TiledContainer->Tabs.begin(), TiledContainer->Tabs.end());
+    }
+    for (auto &FloatingContainer: TargetWorkspace->FloatingContainers) { Windows.push_back(FloatingContainer->Value); }
+    return Windows;
+}
+
+bool WriteToFile(const std::string &Path, const std::string &Contents) {
+    std::ofstream File(Path);
+    File << Contents;
+    File.flush(); // cgroup files report errors on the write itself
+    return File.good();
+}
+
+/* When a process started, in clock ticks since boot, or 0 if it's gone. Pids get reused but never with the same start time */
+uint64_t GetProcessStartTime(pid_t Pid) {
+    std::ifstream Stat("/proc/" + std::to_string(Pid) + "/stat");
+    std::string Contents;
+    std::getline(Stat, Contents);
+    size_t CommandEnd = Contents.rfind(')'); // The command name can hold spaces and brackets of its own
+    if (CommandEnd == std::string::npos) { return 0; }
+    std::istringstream Fields(Contents.substr(CommandEnd + 1));
+    uint64_t StartTime = 0;
+    std::string Field;
+    for (int i = 3; i < 22 && Fields >> Field; i++) {} // Fields 3 to 21 come between the command and the start time
+    if (!(Fields >> StartTime)) { return 0; }
+    return StartTime;
+}
+
+void ThrottleProcess(pid_t Pid, const std::string &Policy) {
+    ThrottledProcess Throttled;
+    Throttled.Policy = Policy;
+    Throttled.StartTime = GetProcessStartTime(Pid);
+    if (Throttled.StartTime == 0) {
+        std::cerr << "Process " << Pid << " is gone, not throttling it" << std::endl;
+        return;
+    }
+    if (Policy == "Stop") {
+        if (kill(Pid, SIGSTOP) != 0) {
+            std::cerr << "Failed to stop process " << Pid << ": " << strerror(errno) << std::endl;
+            return;
+        }
+    } else if (Policy == "CGroup") {
+        std::ifstream CGroups("/proc/" + std::to_string(Pid) + "/cgroup");
+        std::string Line;
+        while (std::getline(CGroups, Line)) {
+            if (Line.rfind("0::", 0) == 0) { Throttled.PreviousCGroup = "/sys/fs/cgroup" + Line.substr(3); } // The unified hierarchy's entry
+        }
+        if (Runtime.Settings.ThrottleCGroup.empty() || Throttled.PreviousCGroup.empty() || !WriteToFile(Runtime.Settings.ThrottleCGroup + "/cgroup.procs", std::to_string(Pid))) {
+            std::cerr << "Failed to move process " << Pid << " into the throttled cgroup " << Runtime.Settings.ThrottleCGroup << std::endl;
+            return;
+        }
+    } else {
+        std::cerr << "No throttle policy called " << Policy << std::endl;
+        return;
+    }
+    ThrottledProcesses[Pid] = Throttled;
+    std::cout << "Throttled process " << Pid << " (" << Policy << ")" << std::endl;
+}
+
+void ResumeProcess(pid_t Pid) {
+    auto Found = ThrottledProcesses.find(Pid);
+    if (Found == ThrottledProcesses.end()) { return; }
+    if (GetProcessStartTime(Pid) != Found->second.StartTime) {
+        std::cout << "Throttled process " << Pid << " exited, nothing to resume" << std::endl;
+        ThrottledProcesses.erase(Found);
+        return;
+    }
+    if (Found->second.Policy == "Stop") {
+        if (kill(Pid, SIGCONT) != 0) { std::cerr << "Failed to continue process " << Pid << ": " << strerror(errno) << std::endl; }
+    } else if (!WriteToFile(Found->second.PreviousCGroup + "/cgroup.procs", std::to_string(Pid))) {
+        std::cerr << "Failed to move process " << Pid << " back into " << Found->second.PreviousCGroup << std::endl;
+    }
+    ThrottledProcesses.erase(Found);
+    std::cout << "Resumed process " << Pid << std::endl;
+}
+
+/* Throttles the processes of a workspace that was just hidden, unless they also have a window that is still shown */
+void ThrottleWorkspace(unsigned int WorkspaceIndex) {
+    std::shared_ptr<Workspace> TargetWorkspace = WM.Workspaces[WorkspaceIndex];
+    if (TargetWorkspace->Throttle == "None") { return; }
+    TraceScope Scope("ThrottleWorkspace", "layout");
+
+    std::vector<std::shared_ptr<Window>> Windows = GetWorkspaceWindows(TargetWorkspace);
+    std::vector<std::shared_ptr<Window>> ShownWindows;
+    for (auto &Monitor: WM.Monitors) {
+        if (Monitor->ActiveWorkspace == -1) { continue; }
+        std::vector<std::shared_ptr<Window>> MonitorWindows = GetWorkspaceWindows(WM.Workspaces[Monitor->ActiveWorkspace]);
+        ShownWindows.insert(ShownWindows.end(), MonitorWindows.begin(), MonitorWindows.end());
+    }
+
+    std::unordered_set<pid_t> ShownPids = {getpid()}; // Never throttle ourselves, in case a client shares our process
+    for (auto &ShownWindow: ShownWindows) { ShownPids.insert(ShownWindow->Pid); }
+    for (auto &TargetWindow: Windows) {
+        if (TargetWindow->Pid <= 0 || TargetWindow->ThrottleExempt || ShownPids.count(TargetWindow->Pid) > 0 || ThrottledProcesses.count(TargetWindow->Pid) > 0) { continue; }
+        ThrottleProcess(TargetWindow->Pid, TargetWorkspace->Throttle);
+    }
+}
+
+/* Resumes the processes of a workspace that is about to be shown, before it's laid out so they can redraw at their new size straight away */
+void ResumeWorkspace(unsigned int WorkspaceIndex) {
+    if (ThrottledProcesses.empty()) { return; }
+    for (auto &TargetWindow: GetWorkspaceWindows(WM.Workspaces[WorkspaceIndex])) {
+        if (TargetWindow->Pid > 0) { ResumeProcess(TargetWindow->Pid); }
+    }
+}
+
+/* Called once a window goes, a throttled process without any managed windows left would never be shown again to resume it */
+void ForgetThrottledProcess(pid_t Pid) {
+    if (ThrottledProcesses.count(Pid) == 0) { return; }
+    for (auto &TargetWorkspace: WM.Workspaces) {
+        for (auto &TargetWindow: GetWorkspaceWindows(TargetWorkspace)) {
+            if (TargetWindow->Pid == Pid) { return; }
+        }
+    }
+    ResumeProcess(Pid);
+}
+
+/* Creates the cgroup for the "CGroup" policy and sets its limit, if one is configured */
+void InitialiseThrottleCGroup() {
+    if (Runtime.Settings.ThrottleCGroup.empty()) { return; }
+    if (mkdir(Runtime.Settings.ThrottleCGroup.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Failed to create the throttled cgroup " << Runtime.Settings.ThrottleCGroup << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    if (!WriteToFile(Runtime.Settings.ThrottleCGroup + "/cpu.max", Runtime.Settings.ThrottleCpuMax)) {
+        std::cerr << "Failed to set cpu.max of " << Runtime.Settings.ThrottleCGroup << ", is the cpu controller enabled for it?" << std::endl;
+        return;
+    }
+    std::cout << "Throttled cgroup " << Runtime.Settings.ThrottleCGroup << " is limited to " << Runtime.Settings.ThrottleCpuMax << std::endl;
+}
+
+// ! PROPERTY WORKER
+/* Picks out what the layout honours from WM_NORMAL_HINTS. The base and minimum sizes stand in for each other when only one is given, as ICCCM says */
+SizeHints ReadSizeHints(const xcb_size_hints_t &Hints) {
+    SizeHints Result;
+    if (Hints.flags & XCB_ICCCM_SIZE_HINT_BASE_SIZE) {
+        Result.BaseWidth = Hints.base_width;
+        Result.BaseHeight = Hints.base_height;
+    } else if (Hints.flags & XCB_ICCCM_SIZE_HINT_P_MIN_SIZE) {
+        Result.BaseWidth = Hints.min_width;
+        Result.BaseHeight = Hints.min_height;
+    }
+    if (Hints.flags & XCB_ICCCM_SIZE_HINT_P_MIN_SIZE) {
+        Result.MinWidth = Hints.min_width;
+        Result.MinHeight = Hints.min_height;
+    } else if (Hints.flags & XCB_ICCCM_SIZE_HINT_BASE_SIZE) {
+        Result.MinWidth = Hints.base_width;
+        Result.MinHeight = Hints.base_height;
+    }
+    if (Hints.flags & XCB_ICCCM_SIZE_HINT_P_MAX_SIZE) {
+        Result.MaxWidth = Hints.max_width;
+        Result.MaxHeight = Hints.max_height;
+    }
+    if (Hints.flags & XCB_ICCCM_SIZE_HINT_P_RESIZE_INC) {
+        Result.WidthIncrement = Hints.width_inc;
+        Result.HeightIncrement = Hints.height_inc;
+    }
+    if ((Hints.flags & XCB_ICCCM_SIZE_HINT_P_ASPECT) && Hints.min_aspect_num > 0 && Hints.max_aspect_den > 0) {
+        Result.MinAspect = static_cast<float>(Hints.min_aspect_den) / Hints.min_aspect_num;
+        Result.MaxAspect = static_cast<float>(Hints.max_aspect_num) / Hints.max_aspect_den;
+    }
+    Result.Set = (Result.BaseWidth || Result.BaseHeight || Result.MinWidth || Result.MinHeight || Result.MaxWidth || Result.MaxHeight || Result.WidthIncrement > 1 || Result.HeightIncrement > 1 || Result.MinAspect > 0);
+    return Result;
+}
+
+/* Reads everything we want to know about a client as it's mapped, in one round trip. Takes the connection so the worker thread can use its own */
+WindowProperties FetchWindowProperties(xcb_connection_t* Connection, xcb_window_t Window) {
+    TraceScope Scope("FetchWindowProperties", "reply");
+    xcb_get_property_cookie_t TypeCookie = xcb_get_property(Connection, 0, Window, WM.ProtocolsContainer.NetWmWindowType, XCB_ATOM_ATOM, 0, 32);
+    xcb_get_property_cookie_t StateCookie = xcb_get_property(Connection, 0, Window, WM.ProtocolsContainer.NetWmState, XCB_ATOM_ATOM, 0, 32);
+    xcb_get_property_cookie_t ProtocolsCookie = xcb_icccm_get_wm_protocols(Connection, Window, WM.ProtocolsContainer.Protocols);
+    xcb_get_property_cookie_t SyncCounterCookie = xcb_get_property(Connection, 0, Window, WM.ProtocolsContainer.NetWmSyncRequestCounter, XCB_ATOM_CARDINAL, 0, 1);
+    xcb_get_property_cookie_t PidCookie = xcb_get_property(Connection, 0, Window, WM.ProtocolsContainer.NetWmPid, XCB_ATOM_CARDINAL, 0, 1);
+    xcb_get_property_cookie_t MachineCookie = xcb_get_property(Connection, 0, Window, XCB_ATOM_WM_CLIENT_MACHINE, XCB_ATOM_STRING, 0, 64);
+    xcb_get_property_cookie_t ClassCookie = xcb_icccm_get_wm_class(Connection, Window);
+    xcb_get_property_cookie_t NetNameCookie = xcb_get_property(Connection, 0, Window, WM.ProtocolsContainer.NetWmName, WM.ProtocolsContainer.Utf8String, 0, 256);
+    xcb_get_property_cookie_t NameCookie = xcb_get_property(Connection, 0, Window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 0, 256);
+    xcb_get_property_cookie_t HintsCookie = xcb_icccm_get_wm_normal_hints(Connection, Window);
+    WindowProperties Properties;
+
+    XcbPointer<xcb_get_property_reply_t> TypeReply(xcb_get_property_reply(Connection, TypeCookie, nullptr));
+    if (TypeReply && TypeReply->type == XCB_ATOM_ATOM && TypeReply->format == 32) {
+        xcb_atom_t* Types = (xcb_atom_t*)xcb_get_property_value(TypeReply.get());
+        Properties.Types.assign(Types, Types + xcb_get_property_value_length(TypeReply.get()) / 4);
+    }
+
+    XcbPointer<xcb_get_property_reply_t> StateReply(xcb_get_property_reply(Connection, StateCookie, nullptr));
+    if (StateReply && StateReply->type == XCB_ATOM_ATOM && StateReply->format == 32) {
+        xcb_atom_t* States = (xcb_atom_t*)xcb_get_property_value(StateReply.get());
+        for (int i = 0; i < xcb_get_property_value_length(StateReply.get()) / 4; i++) {
+            if (States[i] == WM.ProtocolsContainer.NetWmStateFullscreen) { Properties.Fullscreen = true; }
+        }
+    }
+
+    xcb_icccm_get_wm_protocols_reply_t ProtocolsReply;
+    if (xcb_icccm_get_wm_protocols_reply(Connection, ProtocolsCookie, &ProtocolsReply, nullptr) == 1) {
+        Properties.Protocols.assign(ProtocolsReply.atoms, ProtocolsReply.atoms + ProtocolsReply.atoms_len);
+        xcb_icccm_get_wm_protocols_reply_wipe(&ProtocolsReply);
+    }
+
+    // Clients opt into _NET_WM_SYNC_REQUEST through WM_PROTOCOLS, and the counter they'll set is on the window
+    XcbPointer<xcb_get_property_reply_t> SyncCounterReply(xcb_get_property_reply(Connection, SyncCounterCookie, nullptr));
+    bool SupportsSync = std::find(Properties.Protocols.begin(), Properties.Protocols.end(), WM.ProtocolsContainer.NetWmSyncRequest) != Properties.Protocols.end();
+    if (SyncCounterReply && SyncEventBase != 0 && SupportsSync && SyncCounterReply->format == 32 && xcb_get_property_value_length(SyncCounterReply.get()) >= 4) {
+        Properties.SyncCounter = *(xcb_sync_counter_t*)xcb_get_property_value(SyncCounterReply.get());
+    }
+
+    // _NET_WM_PID is only meaningful if WM_CLIENT_MACHINE says the client runs on this machine
+    char Hostname[256] = {};
+    gethostname(Hostname, sizeof(Hostname) - 1);
+    XcbPointer<xcb_get_property_reply_t> PidReply(xcb_get_property_reply(Connection, PidCookie, nullptr));
+    XcbPointer<xcb_get_property_reply_t> MachineReply(xcb_get_property_reply(Connection, MachineCookie, nullptr));
+    bool Local = (MachineReply == nullptr || xcb_get_property_value_length(MachineReply.get()) == 0 || GetPropertyString(MachineReply.get()) == Hostname);
+    if (PidReply && Local && PidReply->format == 32 && xcb_get_property_value_length(PidReply.get()) >= 4) {
+        Properties.Pid = *(uint32_t*)xcb_get_property_value(PidReply.get());
+    }
+
+    xcb_icccm_get_wm_class_reply_t ClassReply;
+    if (xcb_icccm_get_wm_class_reply(Connection, ClassCookie, &ClassReply, nullptr) == 1) {
+        Properties.Class = ClassReply.class_name;
+        Properties.Instance = ClassReply.instance_name;
+        xcb_icccm_get_wm_class_reply_wipe(&ClassReply);
+    }
+
+    XcbPointer<xcb_get_property_reply_t> NetNameReply(xcb_get_property_reply(Connection, NetNameCookie, nullptr));
+    XcbPointer<xcb_get_property_reply_t> NameReply(xcb_get_property_reply(Connection, NameCookie, nullptr));
+    Properties.Title = GetPropertyString(NetNameReply.get());
+    if (Properties.Title.empty()) { Properties.Title = GetPropertyString(NameReply.get()); }
+
+    xcb_size_hints_t Hints;
+    if (xcb_icccm_get_wm_normal_hints_reply(Connection, HintsCookie, &Hints, nullptr) == 1) { Properties.Hints = ReadSizeHints(Hints); }
+    return Properties;
+}
+
+/* Reads only WM_NORMAL_HINTS, for clients that change them after they're mapped. The rest of the properties are left empty */
+WindowProperties FetchSizeHints(xcb_connection_t* Connection, xcb_window_t Window) {
+    TraceScope Scope("FetchSizeHints", "reply");
+    WindowProperties Properties;
+    xcb_size_hints_t Hints;
+    if (xcb_icccm_get_wm_normal_hints_reply(Connection, xcb_icccm_get_wm_normal_hints(Connection, Window), &Hints, nullptr) == 1) { Properties.Hints = ReadSizeHints(Hints); }
+    return Properties;
+}
+
+/* Reads only WM_PROTOCOLS, for closing a window. The rest of the properties are left empty */
+WindowProperties FetchProtocols(xcb_connection_t* Connection, xcb_window_t Window) {
+    TraceScope Scope("FetchProtocols", "reply");
+    WindowProperties Properties;
+    xcb_icccm_get_wm_protocols_reply_t ProtocolsReply;
+    if (xcb_icccm_get_wm_protocols_reply(Connection, xcb_icccm_get_wm_protocols(Connection, Window, WM.ProtocolsContainer.Protocols), &ProtocolsReply, nullptr) == 1) {
+        Properties.Protocols.assign(ProtocolsReply.atoms, ProtocolsReply.atoms + ProtocolsReply.atoms_len);
+        xcb_icccm_get_wm_protocols_reply_wipe(&ProtocolsReply);
+    }
+    return Properties;
+}
+
+/* Which properties a job reads, so callers that only need one don't wait on all of them */
+enum PropertyFetch {
+    FETCH_ALL, // FetchWindowProperties
+    FETCH_HINTS, // FetchSizeHints
+    FETCH_PROTOCOLS, // FetchProtocols
+};
+
+WindowProperties FetchProperties(xcb_connection_t* Connection, xcb_window_t Window, PropertyFetch Fetch) {
+    switch (Fetch) {
+        case FETCH_HINTS: { return FetchSizeHints(Connection, Window); }
+        case FETCH_PROTOCOLS: { return FetchProtocols(Connection, Window); }
+        default: { return FetchWindowProperties(Connection, Window); }
+    }
+}
+
+/* Single producer, single consumer ring buffer, so the worker thread and the event loop can hand each other work without locking */
+template <typename T, size_t Size>
+struct RingBuffer {
+    std::array<T, Size> Items;
+    std::atomic<size_t> Head{0}; // Next item to pop, only the consumer moves it
+    std::atomic<size_t> Tail{0}; // Next slot to push into, only the producer moves it
+
+    bool Push(T &&Item) { // Leaves the item alone if the buffer is full
+        size_t CurrentTail = Tail.load(std::memory_order_relaxed);
+        if (CurrentTail - Head.load(std::memory_order_acquire) == Size) { return false; }
+        Items[CurrentTail % Size] = std::move(Item);
+        Tail.store(CurrentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T &Item) {
+        size_t CurrentHead = Head.load(std::memory_order_relaxed);
+        if (CurrentHead == Tail.load(std::memory_order_acquire)) { return false; }
+        Item = std::move(Items[CurrentHead % Size]);
+        Head.store(CurrentHead + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+struct PropertyJob {
+    uint64_t Id;
+    xcb_window_t Window;
+    PropertyFetch Fetch;
+};
+
+struct PropertyResult {
+    uint64_t Id;
+    WindowProperties Properties;
+};
+
+/* A thread with its own connection to the X server that reads client properties, so the event loop never waits on the replies */
+struct PropertyWorker {
+    xcb_connection_t* Connection = nullptr; // nullptr if the worker couldn't start, properties are then read on the main connection
+    int JobsReady = -1; // eventfd the worker sleeps on
+    int ResultsReady = -1; // eventfd the event loop polls
+    RingBuffer<PropertyJob, 256> Jobs;
+    RingBuffer<PropertyResult, 256> Results;
+    uint64_t NextId = 0;
+    std::unordered_map<uint64_t, std::function<void(const WindowProperties &Properties)>> Continuations; // Only touched by the event loop
+};
+
+static PropertyWorker Worker;
+static std::unordered_set<xcb_window_t> PendingMaps; // Windows that asked to be mapped and are waiting on their properties
+
+void RunPropertyWorker() {
+    while (true) {
+        uint64_t Count;
+        if (read(Worker.JobsReady, &Count, sizeof(Count)) < 0 && errno != EINTR) {
+            std::cerr << "The property worker failed to wait for jobs: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        PropertyJob Job;
+        while (Worker.Jobs.Pop(Job)) {
+            PropertyResult Result = {Job.Id, FetchProperties(Worker.Connection, Job.Window, Job.Fetch)};
+            while (!Worker.Results.Push(std::move(Result))) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); } // The event loop is behind, it drains the results every iteration
+            uint64_t One = 1;
+            write(Worker.ResultsReady, &One, sizeof(One));
+        }
+    }
+}
+
+/* Calls Then with the window's properties once the worker has read them, or straight away if there is no worker or it's too far behind */
+void RequestWindowProperties(xcb_window_t Window, std::function<void(const WindowProperties &Properties)> Then, PropertyFetch Fetch = FETCH_ALL) {
+    uint64_t Id = Worker.NextId++;
+    if (Worker.Connection == nullptr || !Worker.Jobs.Push(PropertyJob{Id, Window, Fetch})) {
+        Then(FetchProperties(WM.Connection, Window, Fetch));
+        return;
+    }
+    Worker.Continuations[Id] = Then;
+    uint64_t One = 1;
+    write(Worker.JobsReady, &One, sizeof(One));
+}
+
+void OnPropertyResults() {
+    uint64_t Count;
+    read(Worker.ResultsReady, &Count, sizeof(Count));
+    PropertyResult Result;
+    while (Worker.Results.Pop(Result)) {
+        auto Found = Worker.Continuations.find(Result.Id);
+        if (Found == Worker.Continuations.end()) { continue; }
+        std::function<void(const WindowProperties &Properties)> Then = std::move(Found->second);
+        Worker.Continuations.erase(Found);
+        Then(Result.Properties);
+    }
+}
+
+void InitialisePropertyWorker() {
+    Worker.Connection = xcb_connect(nullptr, nullptr);
+    Worker.JobsReady = eventfd(0, EFD_CLOEXEC);
+    Worker.ResultsReady = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (xcb_connection_has_error(Worker.Connection) || Worker.JobsReady < 0 || Worker.ResultsReady < 0) {
+        std::cerr << "Failed to start the property worker, client properties will be read on the main connection" << std::endl;
+        xcb_disconnect(Worker.Connection);
+        Worker.Connection = nullptr;
+        return;
+    }
+    std::thread(RunPropertyWorker).detach();
+    std::cout << "Started the property worker" << std::endl;
+}
+
+/* The properties a managed window was mapped with, for mapping it again. Size hints are the latest ones, and the fullscreen state is dropped like it is for any withdrawn window */
+WindowProperties GetCachedProperties(std::shared_ptr<Window> TargetWindow) {
+    WindowProperties Properties = TargetWindow->Properties;
+    Properties.Hints = TargetWindow->Hints;
+    Properties.Fullscreen = false;
+    return Properties;
+}
+
+void FocusContainer(std::shared_ptr<Container> ContainerToFocus) {
+    if (WM.FocusedContainer != nullptr) {
+        if (WM.FocusedContainer->Value->Floating == true) {
+                xcb_change_window_attributes(WM.Connection, WM.FocusedContainer->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveFloatingWindowBorderColour);
+            } else {
+                xcb_change_window_attributes(WM.Connection, WM.FocusedContainer->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveTiledWindowBorderColour);
+            }
+        }
+        std::cout << "Setting window focus to: " << ContainerToFocus->Value->Window << std::endl;
+        int WorkspaceIndex = GetWorkspaceFromContainer(ContainerToFocus);
+        if (WorkspaceIndex != -1) { LinkFocusHistory(ContainerToFocus, WM.Workspaces[WorkspaceIndex], true); }
+        DropWindowOnError(xcb_set_input_focus(WM.Connection, XCB_INPUT_FOCUS_POINTER_ROOT, ContainerToFocus->Value->Window, XCB_CURRENT_TIME), ContainerToFocus->Value->Window);
+        WM.FocusedContainer = ContainerToFocus;
+        if (WM.FocusedContainer->Value->Floating == true) {
+            xcb_change_window_attributes(WM.Connection, WM.FocusedContainer->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.ActiveFloatingWindowBorderColour);
+        } else {
+            xcb_change_window_attributes(WM.Connection, WM.FocusedContainer->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.ActiveTiledWindowBorderColour);
+        }
+    FlushConnection();
+    std::cout << "Finished setting focus" << std::endl;
+}
+
+/* Rules are only applied to new windows, windows the WM remaps itself (eg. toggling floating) keep where the user put them */
+void MapWindowToWM(unsigned int WindowToMap, bool MakeFloating = false, bool ApplyRules = false, const WindowProperties* Properties = nullptr) {
+    TraceScope Scope("MapWindowToWM", "layout");
+    std::shared_ptr<Window> NewWindow = std::make_shared<Window>();
+    NewWindow->Window = WindowToMap;
+    std::shared_ptr<Container> NewContainer = std::make_shared<Container>();
+    NewContainer->Direction = NONE;
+    NewContainer->Parent = nullptr;
+    NewContainer->Value = NewWindow;
+    std::shared_ptr<Monitor> ActiveMonitor = GetActiveMonitor();
+    int WorkspaceIndex = GetActiveWorkspaceEnsureValid(ActiveMonitor);
+
+    // The worker has normally read the properties before we get here, otherwise they're read on the spot
+    WindowProperties Fetched;
+    if (Properties == nullptr) {
+        Fetched = FetchWindowProperties(WM.Connection, WindowToMap);
+        Properties = &Fetched;
+    }
+
+    // Check if the window asked to start fullscreen (eg. games), if so it goes straight to the fullscreen path without laying out the rest of the workspace
+    bool MakeFullscreen = Properties->Fullscreen;
+
+    // Check if window is a popup or similar, if so map it to the center of the current monitor
+    for (xcb_atom_t Type: Properties->Types) {
+        if (Type == WM.ProtocolsContainer.NetWmWindowTypeDialog || Type == WM.ProtocolsContainer.NetWmWindowTypeUtility || Type == WM.ProtocolsContainer.NetWmWindowTypeSplash) {
+            MakeFloating = true;
+        }
+    }
+
+    if (WM.FocusedContainer != nullptr && WM.Workspaces[WorkspaceIndex]->RootContainer != nullptr) {
+        if (WM.FocusedContainer->Value->Floating == true) {
+            MakeFloating = true;
+        }
+    }
+
+    // Rules decide the final workspace and floating state before anything is laid out, so the window is only placed once
+    RuleOutcome Outcome;
+    if (ApplyRules && !Runtime.Rules.empty()) {
+        Outcome = MatchWindowRules(Properties->Class, Properties->Instance, Properties->Title, Properties->Types);
+        if (Outcome.Floating != -1) { MakeFloating = (Outcome.Floating == 1); }
+        if (Outcome.Workspace >= 0) {
+            EnsureValidWorkspacesBetweenIndicesInclusive(WM.Workspaces.size(), Outcome.Workspace);
+            WorkspaceIndex = Outcome.Workspace;
+        }
+    }
+
+    if (Properties->SyncCounter != XCB_NONE) { SetupSyncAlarm(NewWindow, Properties->SyncCounter); }
+    NewWindow->Pid = Properties->Pid;
+    NewWindow->Hints = Properties->Hints;
+    NewWindow->Properties = *Properties;
+    NewWindow->ThrottleExempt = (Runtime.Settings.ThrottleExempt.count(Properties->Class) > 0 || Runtime.Settings.ThrottleExempt.count(Properties->Instance) > 0);
+
+    // The workspace can be hidden if a rule sent the window there, then it's laid out when the workspace is shown
+    std::shared_ptr<Workspace> ActiveWorkspace = WM.Workspaces[WorkspaceIndex];
+    std::shared_ptr<Monitor> WorkspaceMonitor = GetMonitorFromWorkspace_PossibleNullptr(WorkspaceIndex);
+    if (WorkspaceMonitor == nullptr) { WorkspaceMonitor = ActiveMonitor; }
+    bool FocusedIsOnWorkspace = (WM.FocusedContainer != nullptr && GetWorkspaceFromContainer(WM.FocusedContainer) == WorkspaceIndex);
+
+    // A focused tabbed container takes new windows as tabs, so they don't shrink everything else on the workspace
+    if (!MakeFullscreen && !MakeFloating && FocusedIsOnWorkspace && !WM.FocusedContainer->Tabs.empty()) {
+        std::cout << "Adding window " << WindowToMap << " as a tab" << std::endl;
+        std::vector<std::shared_ptr<Window>> &Tabs = WM.FocusedContainer->Tabs;
+        Tabs.insert(std::find(Tabs.begin(), Tabs.end(), WM.FocusedContainer->Value) + 1, NewWindow);
+        ActiveWorkspace->ClientsChanged = true;
+        uint32_t EventMasks[] = {XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_FOCUS_CHANGE | XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_POINTER_MOTION_HINT | XCB_EVENT_MASK_PROPERTY_CHANGE};
+        xcb_change_window_attributes(WM.Connection, WindowToMap, XCB_CW_EVENT_MASK, &EventMasks);
+        int Value = 0;
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WindowToMap, WM.ProtocolsContainer.Floating, XCB_ATOM_CARDINAL, 32, 1, &Value);
+        SelectTab(WM.FocusedContainer, NewWindow);
+        NotifyWindowChange(WindowToMap, "mapped", WorkspaceIndex);
+        return;
+    }
+
+    if (MakeFullscreen && ActiveWorkspace->FullscreenContainer == nullptr) {
+        std::cout << "Window " << WindowToMap << " asked to be mapped fullscreen" << std::endl;
+        ActiveWorkspace->FullscreenContainer = NewContainer;
+        SetWindowFullscreenHints(WindowToMap, true);
+    }
+
+    if (MakeFloating == true) {
+        std::cout << "Window to map is floating, mapping it to 1/2 the current monitor in all respects. Window: " << WindowToMap << std::endl;
+        NewWindow->Floating = true;
+        NewWindow->Size = {(Outcome.Size.X > 0) ? Outcome.Size.X : 0.5f, (Outcome.Size.Y > 0) ? Outcome.Size.Y : 0.5f};
+        NewWindow->Position = {(1.0f - NewWindow->Size.X) / 2, (1.0f - NewWindow->Size.Y) / 2};
+        ActiveWorkspace->FloatingContainers.push_back(NewContainer);
+        LinkFocusHistory(NewContainer, ActiveWorkspace, false);
+        ActiveWorkspace->ClientsChanged = true;
+        uint32_t EventMasks[] = {XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_FOCUS_CHANGE | XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_POINTER_MOTION_HINT | XCB_EVENT_MASK_PROPERTY_CHANGE};
+        xcb_change_window_attributes(WM.Connection, WindowToMap, XCB_CW_EVENT_MASK, &EventMasks);
+        xcb_change_window_attributes(WM.Connection, WindowToMap, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveFloatingWindowBorderColour);
+
+        int Value = 1;
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WindowToMap, WM.ProtocolsContainer.Floating, XCB_ATOM_CARDINAL, 32, 1, &Value);
+
+        UpdateWindowToCurrentSplits(NewContainer);
+        CommitPendingGeometry(); // So the window is mapped at its final size
+        DropWindowOnError(xcb_map_window(WM.Connection, WindowToMap), WindowToMap);
+        RestackWorkspace(ActiveWorkspace);
+        FlushConnection();
+        NotifyWindowChange(WindowToMap, "mapped", WorkspaceIndex);
+        return;
+    }
+
+    std::shared_ptr<Container> RelayoutContainer = NewContainer; // The smallest subtree the new window changes
+    if (ActiveWorkspace->RootContainer != nullptr) { // Need to create a split, this isn't the first window opened
+        const Layout &WorkspaceLayout = GetWorkspaceLayout(ActiveWorkspace);
+        if (WorkspaceLayout.Insertion == SPLIT_SHALLOWEST) {
+            std::shared_ptr<Container> Shallowest = GetShallowestContainer(ActiveWorkspace->RootContainer);
+            LayoutRect Area = GetContainerArea(Shallowest, WorkspaceMonitor);
+            InsertContainerBeside(Shallowest, NewContainer, (Area.Width >= Area.Height) ? RIGHT : DOWN, ActiveWorkspace);
+        } else if (FocusedIsOnWorkspace) { // Create window size & splits based on the focused window
+            WindowSegment Section = (WorkspaceLayout.Insertion == SPLIT_FOCUSED) ? GetWindowSegmentCursorIsIn(WM.FocusedContainer->Value) : RIGHT;
+            InsertContainerBeside(WM.FocusedContainer, NewContainer, Section, ActiveWorkspace);
+        } else { // Nothing is focused here (eg. a rule sent it, or nothing has the pointer), so it goes beside the window focused last
+            std::shared_ptr<Container> LastFocused = ActiveWorkspace->FocusHistory;
+            if (LastFocused == nullptr || LastFocused->Value->Floating) { LastFocused = GetShallowestContainer(ActiveWorkspace->RootContainer); }
+            InsertContainerBeside(LastFocused, NewContainer, RIGHT, ActiveWorkspace);
+        }
+        RelayoutContainer = NewContainer->Parent;
+
+        if (WorkspaceLayout.Insertion == AFTER_FOCUSED) { // Only the order matters to these layouts, so rebuild the tree once it gets much deeper than it needs to be
+            int Depth = 0;
+            for (std::shared_ptr<Container> CurrentContainer = NewContainer; CurrentContainer->Parent != nullptr; CurrentContainer = CurrentContainer->Parent) { Depth++; }
+            if (Depth > REBALANCE_MINIMUM_DEPTH && Depth > 2 * std::log2(GetTiledContainersInOrder(ActiveWorkspace->RootContainer).size())) {
+                RebalanceTree(ActiveWorkspace, GetTilingArea(WorkspaceMonitor));
+                RelayoutContainer = ActiveWorkspace->RootContainer;
+            }
         }
     } else { // First window opened
         std::cout << "No root, making new root" << std::endl;
         ActiveWorkspace->RootContainer = NewContainer;
     }
 
-    uint32_t EventMasks[] = {XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_FOCUS_CHANGE};
+    LinkFocusHistory(NewContainer, ActiveWorkspace, false);
+    ActiveWorkspace->ClientsChanged = true;
+    uint32_t EventMasks[] = {XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_FOCUS_CHANGE | XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_POINTER_MOTION_HINT | XCB_EVENT_MASK_PROPERTY_CHANGE};
     xcb_change_window_attributes(WM.Connection, WindowToMap, XCB_CW_EVENT_MASK, &EventMasks);
     xcb_change_window_attributes(WM.Connection, WindowToMap, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveTiledWindowBorderColour);
     int Value = 0;
-    xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WindowToMap, GetAtom("FLOATING"), XCB_ATOM_CARDINAL, 32, 1, &Value);
-    UpdateWindowToCurrentSplits(NewContainer);
-    if (FullscreenRefreshNeeded == true) { UpdateWindowToCurrentSplits(WM.FocusedContainer); SendWindowToFront(WM.FocusedContainer->Value->Window); } // We map the fullscreened window after so it appears ontop
+    xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WindowToMap, WM.ProtocolsContainer.Floating, XCB_ATOM_CARDINAL, 32, 1, &Value);
+    UpdateWindowSplitsRecursively(RelayoutContainer);
     std::cout << "ADDED! " << WindowToMap << std::endl;
     PrintVisibleWindows();
 
-    xcb_map_window(WM.Connection, WindowToMap);
-    xcb_flush(WM.Connection);
-
-    for (auto Floater: ActiveWorkspace->FloatingContainers) {
-        SendWindowToFront(Floater->Value->Window);
-    }
+    CommitPendingGeometry(); // So the window is mapped at its final size
+    DropWindowOnError(xcb_map_window(WM.Connection, WindowToMap), WindowToMap);
+    RestackWorkspace(ActiveWorkspace);
+    FlushConnection();
+    NotifyWindowChange(WindowToMap, "mapped", WorkspaceIndex);
 }
 
 void RemoveContainerFromWM(std::shared_ptr<Container> ToBeRemoved, int Workspace) {
+    TraceScope Scope("RemoveContainerFromWM", "layout");
     std::cout << "Removing container from WM" << std::endl;
+    PendingCommits.erase(ToBeRemoved->Value->Window);
+    DestroySyncAlarm(ToBeRemoved->Value);
+    UnindexContainer(ToBeRemoved);
+    if (DraggedWindow == ToBeRemoved) { DraggedWindow = nullptr; }
+    WM.Workspaces[Workspace]->ClientsChanged = true;
+    NotifyWindowChange(ToBeRemoved->Value->Window, "removed", Workspace);
+    UnlinkFocusHistory(ToBeRemoved, WM.Workspaces[Workspace]);
     if (WM.FocusedContainer == ToBeRemoved) {
         WM.FocusedContainer = nullptr;
-        std::cout << "Focused Container was deleted, setting to nullptr" << std::endl;    
+        if (WM.Workspaces[Workspace]->FocusHistory != nullptr) {
+            std::cout << "Focused Container was deleted, focusing the window focused before it" << std::endl;
+            FocusContainer(WM.Workspaces[Workspace]->FocusHistory);
+        } else {
+            std::cout << "Focused Container was deleted, setting to nullptr" << std::endl;    
+        }
     }
 
-    if (WM.Workspaces[Workspace]->FullscreenContainer == ToBeRemoved) {
+    bool WasFullscreen = (WM.Workspaces[Workspace]->FullscreenContainer == ToBeRemoved);
+    if (WasFullscreen) {
         WM.Workspaces[Workspace]->FullscreenContainer = nullptr;
+        SetWindowFullscreenHints(ToBeRemoved->Value->Window, false); // Withdrawn windows don't keep their state
         std::cout << "Fullscreened Container was deleted, setting to nullptr" << std::endl;    
     }
 
     if (ToBeRemoved->Value->Floating == true) { // Floating Logic
         WM.Workspaces[Workspace]->FloatingContainers.erase(std::remove(WM.Workspaces[Workspace]->FloatingContainers.begin(), WM.Workspaces[Workspace]->FloatingContainers.end(), ToBeRemoved), WM.Workspaces[Workspace]->FloatingContainers.end());
         xcb_change_window_attributes(WM.Connection, ToBeRemoved->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveFloatingWindowBorderColour); // Incase the window is planned to be remapped later
-        xcb_flush(WM.Connection);
+        FlushConnection();
 
     } else { // Tiling logic
         xcb_change_window_attributes(WM.Connection, ToBeRemoved->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveTiledWindowBorderColour);
-        xcb_flush(WM.Connection);
-
-        if (!(ToBeRemoved->Parent == nullptr)) {
-            std::shared_ptr<Container> PromotionContainer; // We choose the other window to be promoted
-            if (ToBeRemoved->Parent->Left == ToBeRemoved) {
-                PromotionContainer = ToBeRemoved->Parent->Right;
-            } else {
-                PromotionContainer = ToBeRemoved->Parent->Left;
-            }
-
-            if (ToBeRemoved->Parent->Parent != nullptr) { // Swapping the parent container to be the promotion container
-                if (ToBeRemoved->Parent->Parent->Left == ToBeRemoved->Parent ) {
-                    ToBeRemoved->Parent->Parent->Left = PromotionContainer;
-                } else {
-                    ToBeRemoved->Parent->Parent->Right = PromotionContainer;
-                }
-                PromotionContainer->Parent = ToBeRemoved->Parent->Parent;
-            } else { // Do the same thing, but no need to modify the parent's parent, as the parent of promotion container is already the root container
-                ToBeRemoved->Parent = PromotionContainer;
-                WM.Workspaces[Workspace]->RootContainer = PromotionContainer;
-                PromotionContainer->Parent = nullptr;
-            }
+        FlushConnection();
 
+        std::shared_ptr<Container> PromotionContainer = DetachContainerFromTree(ToBeRemoved, WM.Workspaces[Workspace]);
+        if (PromotionContainer != nullptr) {
             std::cout << "After reconfigurement" << std::endl;
             PrintVisibleWindows();
 
@@ -576,20 +2522,30 @@ void RemoveContainerFromWM(std::shared_ptr<Container> ToBeRemoved, int Workspace
             UpdateWindowSplitsRecursively(PromotionContainer);
 
         } else {
-            WM.Workspaces[Workspace]->RootContainer = nullptr;
             std::cout << "Root container was deleted, setting to nullptr" << std::endl;    
         }
     }
+
+    if (WasFullscreen) { // The rest of the workspace was suspended underneath it
+        UpdateWorkspaceSplits(Workspace);
+        RestackWorkspace(WM.Workspaces[Workspace]);
+    }
 }
 
-void EnsureValidWorkspacesBetweenIndicesInclusive(int LowerBound, int UpperBound) {
-    for (int i = LowerBound; i <= UpperBound; i++) {
-        if (static_cast<int>(WM.Workspaces.size()-1) < i) { // Current Index doesn't exist -- create a new one
-            std::shared_ptr<Workspace> NewWorkspace = std::make_shared<Workspace>();
-            WM.Workspaces.push_back(NewWorkspace);
-            std::cout << "Created Workspace at Index " << i << ", ensuring a valid range" << std::endl;
-        }
+/* Drops a client from the WM. A tabbed container with other tabs only loses the window, otherwise the whole container goes */
+void RemoveWindowFromWM(xcb_window_t Window) {
+    auto Result = GetWorkspaceAndContainerFromWindow_PossibleNullptr(Window);
+    if (Result == nullptr) { return; }
+    pid_t Pid = Result->Container->Value->Pid;
+    for (auto &Tab: Result->Container->Tabs) {
+        if (Tab->Window == Window) { Pid = Tab->Pid; }
+    }
+    if (Result->Container->Tabs.size() > 1) {
+        RemoveTab(Result->Container, Window, Result->Workspace);
+    } else {
+        RemoveContainerFromWM(Result->Container, Result->Workspace);
     }
+    if (Pid > 0) { ForgetThrottledProcess(Pid); }
 }
 
 void AssignFreeWorkspaceToMonitor(std::shared_ptr<Monitor> Monitor) {
@@ -605,6 +2561,7 @@ void AssignFreeWorkspaceToMonitor(std::shared_ptr<Monitor> Monitor) {
         auto Found = std::find(ClaimedWorkspaces.begin(), ClaimedWorkspaces.end(), i);
         if (Found == ClaimedWorkspaces.end()) { // Allocates any spare workspaces
             Monitor->ActiveWorkspace = i;
+            ResumeWorkspace(i); // It was hidden until now, so it may have been throttled
             std::cout << "Assigned Monitor: " << Monitor->Name << ", Pre-existing Workspace: " << i << " (Should be same as " << Monitor->ActiveWorkspace << ")" << std::endl;
             return;
         }
@@ -619,24 +2576,251 @@ void AssignFreeWorkspaceToMonitor(std::shared_ptr<Monitor> Monitor) {
     << " (Should be same as " << Monitor->ActiveWorkspace << ")" << std::endl;
 }
 
-void FocusContainer(std::shared_ptr<Container> ContainerToFocus) {
-    if (WM.FocusedContainer != nullptr) {
-        if (WM.FocusedContainer->Value->Floating == true) {
-                xcb_change_window_attributes(WM.Connection, WM.FocusedContainer->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveFloatingWindowBorderColour);
-            } else {
-                xcb_change_window_attributes(WM.Connection, WM.FocusedContainer->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveTiledWindowBorderColour);
+// ! WARM POOL
+/* An instance of a WarmPool command, launched before its keybind is pressed */
+struct WarmProcess {
+    std::string Command;
+    pid_t Pid;
+    xcb_window_t Window = XCB_NONE; // XCB_NONE until the process maps a window
+    uint64_t LaunchTime = 0; // Monotonic time in nanoseconds, so a command that dies straight away isn't relaunched over and over
+};
+
+static std::vector<WarmProcess> WarmPool;
+static int ChildSignals = -1; // signalfd for SIGCHLD, so children are reaped from the event loop instead of being left as zombies
+
+/* SIGCHLD is blocked so it only arrives through ChildSignals, children have to unblock it before they exec or they'd keep it blocked */
+void UnblockChildSignals() {
+    sigset_t Mask;
+    sigemptyset(&Mask);
+    sigaddset(&Mask, SIGCHLD);
+    sigprocmask(SIG_UNBLOCK, &Mask, nullptr);
+}
+
+/* Launches instances of the WarmPool commands until each has as many as configured. OnChildSignals reaps the ones that died and takes them out of the pool */
+void ReplenishWarmPool() {
+    for (auto &Pair: Runtime.Settings.WarmPool) {
+        int Count = std::count_if(WarmPool.begin(), WarmPool.end(), [&](const WarmProcess &Process) { return Process.Command == Pair.first; });
+        for (; Count < Pair.second; Count++) {
+            pid_t Pid = fork();
+            if (Pid == 0) {
+                UnblockChildSignals();
+                std::string Command = "exec " + Pair.first; // So the client keeps the pid we match its window by
+                execl("/bin/sh", "/bin/sh", "-c", Command.c_str(), (void *)NULL);
+                _exit(EXIT_FAILURE);
             }
+            if (Pid < 0) {
+                std::cerr << "Failed to fork a warm instance of " << Pair.first << ": " << strerror(errno) << std::endl;
+                return;
+            }
+            WarmPool.push_back({Pair.first, Pid, XCB_NONE, GetMonotonicTime()});
+            std::cout << "Launched a warm instance of " << Pair.first << ", pid: " << Pid << std::endl;
         }
-        std::cout << "Setting window focus to: " << ContainerToFocus->Value->Window << std::endl;
-        xcb_set_input_focus(WM.Connection, XCB_INPUT_FOCUS_POINTER_ROOT, ContainerToFocus->Value->Window, XCB_CURRENT_TIME);
-        WM.FocusedContainer = ContainerToFocus;
-        if (WM.FocusedContainer->Value->Floating == true) {
-            xcb_change_window_attributes(WM.Connection, WM.FocusedContainer->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.ActiveFloatingWindowBorderColour);
+    }
+}
+
+/* If the window belongs to a warm instance that hasn't mapped one yet, it's mapped offscreen outside of every workspace instead of being managed, so the client finishes starting up and drawing */
+bool AdoptWarmWindow(xcb_window_t Window, pid_t Pid) {
+    auto Found = std::find_if(WarmPool.begin(), WarmPool.end(), [&](const WarmProcess &Process) { return Process.Window == XCB_NONE && Process.Pid == Pid; });
+    if (Pid == 0 || Found == WarmPool.end()) { return false; }
+
+    Found->Window = Window;
+    std::shared_ptr<Monitor> ActiveMonitor = GetActiveMonitor();
+    uint32_t Parameters[] = {0, static_cast<uint32_t>(WM.Screen->height_in_pixels * OFFSCREEN_WINDOW_MULTIPLIER), static_cast<uint32_t>(ActiveMonitor->Width / 2), static_cast<uint32_t>(ActiveMonitor->Height / 2)};
+    DropWindowOnError(xcb_configure_window(WM.Connection, Window, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, Parameters), Window); // The client can die before these arrive
+    DropWindowOnError(xcb_map_window(WM.Connection, Window), Window);
+    FlushConnection();
+    std::cout << "Window " << Window << " of " << Found->Command << " is warm" << std::endl;
+    return true;
+}
+
+/* Hands a warm window of the command to the focused workspace through the usual insertion path, false if none is ready */
+bool ClaimWarmWindow(const std::string &Command) {
+    auto Found = std::find_if(WarmPool.begin(), WarmPool.end(), [&](const WarmProcess &Process) { return Process.Command == Command && Process.Window != XCB_NONE; });
+    if (Found == WarmPool.end()) { return false; }
+
+    xcb_window_t Window = Found->Window;
+    WarmPool.erase(Found);
+    std::cout << "Claimed warm window " << Window << " for " << Command << std::endl;
+    PendingMaps.insert(Window);
+    RequestWindowProperties(Window, [Window](const WindowProperties &Properties) { // Read again, the title has likely changed since it was adopted
+        if (PendingMaps.erase(Window) == 0) { return; } // Withdrawn or destroyed while its properties were read
+        MapWindowToWM(Window, false, true, &Properties);
+    });
+    ReplenishWarmPool();
+    return true;
+}
+
+/* Reaps every child that exited, warm instances among them are replaced unless they died as soon as they were launched */
+void OnChildSignals() {
+    signalfd_siginfo Info;
+    while (read(ChildSignals, &Info, sizeof(Info)) == sizeof(Info)) {} // Signals for several children merge into one, so waitpid decides who exited
+
+    bool Replenish = false;
+    pid_t Pid;
+    while ((Pid = waitpid(-1, nullptr, WNOHANG)) > 0) {
+        auto Found = std::find_if(WarmPool.begin(), WarmPool.end(), [&](const WarmProcess &Process) { return Process.Pid == Pid; });
+        if (Found == WarmPool.end()) { continue; }
+        if (GetMonotonicTime() - Found->LaunchTime < 1000000000) {
+            std::cerr << "Warm instance " << Pid << " of " << Found->Command << " exited straight after it was launched, not replacing it until the next claim" << std::endl;
         } else {
-            xcb_change_window_attributes(WM.Connection, WM.FocusedContainer->Value->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.ActiveTiledWindowBorderColour);
+            std::cout << "Warm instance " << Pid << " of " << Found->Command << " exited" << std::endl;
+            Replenish = true;
         }
-    xcb_flush(WM.Connection);
-    std::cout << "Finished setting focus" << std::endl;
+        WarmPool.erase(Found);
+    }
+    if (Replenish) { ReplenishWarmPool(); }
+}
+
+/* Blocks SIGCHLD and opens ChildSignals for it. Has to run before any thread is started, so none of them can take the signal instead */
+void InitialiseChildSignals() {
+    sigset_t Mask;
+    sigemptyset(&Mask);
+    sigaddset(&Mask, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &Mask, nullptr) != 0) {
+        std::cerr << "Failed to block SIGCHLD, exited children won't be reaped: " << strerror(errno) << std::endl;
+        return;
+    }
+    ChildSignals = signalfd(-1, &Mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (ChildSignals < 0) {
+        std::cerr << "Failed to open a signalfd for SIGCHLD, exited children won't be reaped: " << strerror(errno) << std::endl;
+        sigprocmask(SIG_UNBLOCK, &Mask, nullptr);
+    }
+}
+
+/* A warm window that goes away before it's claimed is replaced */
+void ForgetWarmWindow(xcb_window_t Window) {
+    auto Found = std::find_if(WarmPool.begin(), WarmPool.end(), [&](const WarmProcess &Process) { return Process.Window == Window; });
+    if (Found == WarmPool.end()) { return; }
+    std::cout << "Warm window " << Window << " of " << Found->Command << " went away" << std::endl;
+    WarmPool.erase(Found);
+    ReplenishWarmPool();
+}
+
+// ! STATE SNAPSHOT
+const uint32_t SNAPSHOT_MAGIC = 0x45584552; // "EXER"
+const uint32_t SNAPSHOT_VERSION = 1;
+const int SNAPSHOT_MONITORS = 16;
+const int SNAPSHOT_WORKSPACES = 64;
+
+struct SnapshotMonitor {
+    char Name[32]; // Null terminated, cut short if it doesn't fit
+    int32_t X;
+    int32_t Y;
+    int32_t Width;
+    int32_t Height;
+    int32_t ActiveWorkspace;
+};
+
+struct SnapshotWorkspace {
+    uint32_t Windows; // Including hidden tabs and floating windows
+    uint32_t FullscreenWindow; // XCB_NONE unless a window is fullscreened on it
+};
+
+struct SnapshotState {
+    uint32_t MonitorCount;
+    uint32_t WorkspaceCount;
+    uint32_t FocusedWindow;
+    int32_t FocusedWorkspace;
+    SnapshotMonitor Monitors[SNAPSHOT_MONITORS];
+    SnapshotWorkspace Workspaces[SNAPSHOT_WORKSPACES];
+};
+
+/* Layout of the shared memory object, readers map it read only and never talk to us or the X server.
+Sequence is odd while we're writing, ReadStateSnapshot is how a reader gets a State that wasn't torn by a write */
+struct SnapshotSegment {
+    uint32_t Magic;
+    uint32_t Version;
+    std::atomic<uint64_t> Sequence;
+    SnapshotState State;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The snapshot sequence has to be lock free to be shared between processes");
+
+static SnapshotSegment* Snapshot = nullptr;
+static SnapshotState LastSnapshot = {}; // What the segment holds, so iterations that changed nothing don't make readers retry
+
+/* The writer's half of the sequence lock. Only the WM writes, so the sequence needs no read-modify-write */
+void WriteStateSnapshot(SnapshotSegment* Segment, const SnapshotState &State) {
+    uint64_t Sequence = Segment->Sequence.load(std::memory_order_relaxed);
+    Segment->Sequence.store(Sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); // Readers must see the odd sequence before any of the new state
+    memcpy(&Segment->State, &State, sizeof(SnapshotState));
+    Segment->Sequence.store(Sequence + 2, std::memory_order_release);
+}
+
+/* The reader's half, what a status bar does with its own mapping. The first load is acquire so the copy can't be read before it, and the acquire fence keeps the copy
+from being read after the second load. False if a write was in the way every time, Retries counts the attempts that were thrown away */
+bool ReadStateSnapshot(const SnapshotSegment* Segment, SnapshotState &State, uint64_t* Retries = nullptr) {
+    for (int Attempt = 0; Attempt < 1000000; Attempt++) {
+        uint64_t Before = Segment->Sequence.load(std::memory_order_acquire);
+        if (Before % 2 == 0) {
+            memcpy(&State, &Segment->State, sizeof(SnapshotState));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (Segment->Sequence.load(std::memory_order_relaxed) == Before) { return true; }
+        }
+        if (Retries != nullptr) { (*Retries)++; }
+    }
+    return false;
+}
+
+void InitialiseStateSnapshot() {
+    if (Runtime.Settings.StateSnapshot.empty()) { return; }
+    int Descriptor = shm_open(Runtime.Settings.StateSnapshot.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (Descriptor == -1) {
+        std::cerr << "Failed to open the state snapshot " << Runtime.Settings.StateSnapshot << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    if (ftruncate(Descriptor, sizeof(SnapshotSegment)) != 0) {
+        std::cerr << "Failed to size the state snapshot " << Runtime.Settings.StateSnapshot << ": " << strerror(errno) << std::endl;
+        close(Descriptor);
+        return;
+    }
+    void* Mapping = mmap(nullptr, sizeof(SnapshotSegment), PROT_READ | PROT_WRITE, MAP_SHARED, Descriptor, 0);
+    close(Descriptor); // The mapping keeps the object alive
+    if (Mapping == MAP_FAILED) {
+        std::cerr << "Failed to map the state snapshot " << Runtime.Settings.StateSnapshot << ": " << strerror(errno) << std::endl;
+        return;
+    }
+
+    // A previous run may have left a segment behind, carry on from its sequence so readers holding it never see it go backwards
+    Snapshot = static_cast<SnapshotSegment*>(Mapping);
+    uint64_t Sequence = Snapshot->Sequence.load(std::memory_order_relaxed);
+    Snapshot->Sequence.store(Sequence & ~1ULL, std::memory_order_relaxed); // In case the last run died halfway through a write
+    Snapshot->Magic = SNAPSHOT_MAGIC;
+    Snapshot->Version = SNAPSHOT_VERSION;
+    WriteStateSnapshot(Snapshot, LastSnapshot);
+    std::cout << "Publishing the state snapshot to /dev/shm" << Runtime.Settings.StateSnapshot << std::endl;
+}
+
+/* Copies the state readers care about into the segment if it changed, at most once per event loop iteration.
+Runs after PublishEWMH, so the window counts come from the client lists it only rebuilds for workspaces that gained or lost windows */
+void PublishStateSnapshot() {
+    if (Snapshot == nullptr) { return; }
+    TraceScope Scope("PublishStateSnapshot", "layout");
+
+    SnapshotState State = {};
+    State.MonitorCount = std::min<size_t>(WM.Monitors.size(), SNAPSHOT_MONITORS);
+    for (uint32_t i = 0; i < State.MonitorCount; i++) {
+        SnapshotMonitor &Entry = State.Monitors[i];
+        strncpy(Entry.Name, WM.Monitors[i]->Name.c_str(), sizeof(Entry.Name) - 1);
+        Entry.X = WM.Monitors[i]->X;
+        Entry.Y = WM.Monitors[i]->Y;
+        Entry.Width = WM.Monitors[i]->Width;
+        Entry.Height = WM.Monitors[i]->Height;
+        Entry.ActiveWorkspace = WM.Monitors[i]->ActiveWorkspace;
+    }
+    State.WorkspaceCount = std::min<size_t>(WM.Workspaces.size(), SNAPSHOT_WORKSPACES);
+    for (uint32_t i = 0; i < State.WorkspaceCount; i++) {
+        State.Workspaces[i].Windows = WM.Workspaces[i]->PublishedClients.size();
+        State.Workspaces[i].FullscreenWindow = (WM.Workspaces[i]->FullscreenContainer != nullptr) ? WM.Workspaces[i]->FullscreenContainer->Value->Window : XCB_NONE;
+    }
+    State.FocusedWindow = (WM.FocusedContainer != nullptr) ? WM.FocusedContainer->Value->Window : XCB_NONE;
+    State.FocusedWorkspace = (WM.FocusedContainer != nullptr) ? GetWorkspaceFromContainer(WM.FocusedContainer) : -1;
+
+    // Zero initialised and written field by field, so the padding matches too
+    if (memcmp(&State, &LastSnapshot, sizeof(SnapshotState)) == 0) { return; }
+    LastSnapshot = State;
+    WriteStateSnapshot(Snapshot, State);
 }
 
 // ! COMMANDS
@@ -644,12 +2828,12 @@ void ChangeFloatingWindow(bool Position) {
     if (DraggedWindow == nullptr) {
         if (WM.FocusedContainer != nullptr) {
             if (WM.FocusedContainer->Value->Floating == true) {
-                xcb_get_geometry_reply_t* Geometry = xcb_get_geometry_reply(WM.Connection, xcb_get_geometry(WM.Connection, WM.FocusedContainer->Value->Window), NULL);
+                Geometry WindowGeometry = GetWindowGeometry(WM.FocusedContainer->Value);
                 DraggedWindow = WM.FocusedContainer;
                 Coordinate MousePosition = GetCursorPosition();
-                std::shared_ptr<Monitor> Monitor = GetMonitorFromWorkspace_PossibleNullptr(GetWorkspaceAndContainerFromWindow_PossibleNullptr(DraggedWindow->Value->Window)->Workspace);
-                InitialDraggingPosition.X = (MousePosition.X - Geometry->x) / Monitor->Width;
-                InitialDraggingPosition.Y = (MousePosition.Y - Geometry->y) / Monitor->Height;
+                std::shared_ptr<Monitor> Monitor = GetMonitorFromWorkspace_PossibleNullptr(GetWorkspaceFromContainer(DraggedWindow));
+                InitialDraggingPosition.X = (MousePosition.X - WindowGeometry.X) / Monitor->Width;
+                InitialDraggingPosition.Y = (MousePosition.Y - WindowGeometry.Y) / Monitor->Height;
                 std::cout << "Initial Drag Pos : " << InitialDraggingPosition.X << " " << InitialDraggingPosition.Y << std::endl; 
 
                 Repositioning = Position;
@@ -677,11 +2861,12 @@ void MoveFloatingWindow(WindowSegment Direction) {
 void ToggleActiveWindowFloating() {
     if (WM.FocusedContainer != nullptr) {
         if (WM.FocusedContainer->Value->Floating == false) { // Tiling to Floating Logic
-            std::shared_ptr<Container> RemovalContainer = WM.FocusedContainer;
-            int Workspace = GetWorkspaceAndContainerFromWindow_PossibleNullptr(WM.FocusedContainer->Value->Window)->Workspace;
-            RemoveContainerFromWM(WM.FocusedContainer, Workspace);
-            MapWindowToWM(RemovalContainer->Value->Window, true);
-            if (WM.FocusedContainer == nullptr) { FocusContainer(GetWorkspaceAndContainerFromWindow_PossibleNullptr(RemovalContainer->Value->Window)->Container); }
+            xcb_window_t Window = WM.FocusedContainer->Value->Window; // A tabbed container shows another window once this one is removed
+            WindowProperties Properties = GetCachedProperties(WM.FocusedContainer->Value);
+            RemoveWindowFromWM(Window);
+            MapWindowToWM(Window, true, false, &Properties);
+            auto Result = GetWorkspaceAndContainerFromWindow_PossibleNullptr(Window);
+            if (Result != nullptr) { FocusContainer(Result->Container); } // Taken back from the window that had it while this one was remapped
         }
     }
 }
@@ -690,11 +2875,7 @@ void ChangeActiveWindowSplitDirection() {
     if (WM.FocusedContainer != nullptr) {
         if (WM.FocusedContainer->Value->Floating == true) { return; } 
         if (WM.FocusedContainer->Parent != nullptr) {
-            if (WM.FocusedContainer->Parent->Direction == VERTICAL) {
-                WM.FocusedContainer->Parent->Direction = HORIZONTAL;
-            } else {
-                WM.FocusedContainer->Parent->Direction = VERTICAL;
-            }
+            FlipContainerSplit(WM.FocusedContainer->Parent);
             UpdateWindowSplitsRecursively(WM.FocusedContainer->Parent);
         }
     }
@@ -702,32 +2883,29 @@ void ChangeActiveWindowSplitDirection() {
 
 void SwapActiveWindowSides() {
     if (WM.FocusedContainer != nullptr) {
-        if (WM.FocusedContainer->Value->Floating == true) { return; } 
-        if (WM.FocusedContainer->Parent != nullptr) {
-            if (WM.FocusedContainer->Parent->Left == WM.FocusedContainer) {
-                WM.FocusedContainer->Parent->Left = WM.FocusedContainer->Parent->Right;
-                WM.FocusedContainer->Parent->Right = WM.FocusedContainer;
-            } else {
-                WM.FocusedContainer->Parent->Right = WM.FocusedContainer->Parent->Left;
-                WM.FocusedContainer->Parent->Left = WM.FocusedContainer;
-
-            }
+        if (WM.FocusedContainer->Value->Floating == true) { return; } 
+        if (WM.FocusedContainer->Parent != nullptr) {
+            SwapContainerChildren(WM.FocusedContainer->Parent);
             UpdateWindowSplitsRecursively(WM.FocusedContainer->Parent);
         }
     }
 }
 
+// The window MoveActiveWindow took off the screen, until it's pressed again to put it down. OnDestroyNotify clears it if the window goes in between
+static xcb_window_t WindowToMove = XCB_NONE;
+static WindowProperties WindowToMoveProperties;
+
 void MoveActiveWindow() {
-    static int WindowToMove = -1;
-    if (WindowToMove == -1) {
+    if (WindowToMove == XCB_NONE) {
         if (WM.FocusedContainer != nullptr) {
             WindowToMove = WM.FocusedContainer->Value->Window;
+            WindowToMoveProperties = GetCachedProperties(WM.FocusedContainer->Value);
             xcb_unmap_window(WM.Connection, WindowToMove);
-            xcb_flush(WM.Connection);
+            FlushConnection();
         }
     } else {
-        MapWindowToWM(WindowToMove);
-        WindowToMove = -1;
+        MapWindowToWM(WindowToMove, false, false, &WindowToMoveProperties);
+        WindowToMove = XCB_NONE;
     }
 }
 
@@ -743,49 +2921,287 @@ void ResizeActiveWindow(WindowSegment Direction) {
                 case DOWN: { WM.FocusedContainer->Value->Size.Y = std::clamp(WM.FocusedContainer->Value->Size.Y + RESIZE_INCREMEMNT, 0.0f, 1.0f - WM.FocusedContainer->Value->Position.Y); break; }
             }
             UpdateWindowToCurrentSplits(WM.FocusedContainer);
-        } else { // Tiling Logic
-            Split TargetSplit;
-            if (Direction == LEFT || Direction == RIGHT) { TargetSplit = VERTICAL; } else { TargetSplit = HORIZONTAL; }    
-            std::shared_ptr<Container>* TargetContainer = &WM.FocusedContainer;
-            while (TargetContainer->get()->Parent != nullptr) {
-                TargetContainer = &TargetContainer->get()->Parent;
-                if (TargetContainer->get()->Direction == TargetSplit) {
-                    if (Direction == RIGHT || Direction == DOWN) {
-                        TargetContainer->get()->Ratio = std::clamp(TargetContainer->get()->Ratio + RESIZE_INCREMEMNT, 0.05f, 0.95f);
-                    } else {
-                        TargetContainer->get()->Ratio = std::clamp(TargetContainer->get()->Ratio - RESIZE_INCREMEMNT, 0.05f, 0.95f);
-                    }
-                    UpdateWindowSplitsRecursively(*TargetContainer);
-                    break;
-                }
+        } else if (!GetWorkspaceLayout(WM.Workspaces[GetWorkspaceFromContainer(WM.FocusedContainer)]).FollowsTree) { // Layout has no ratios of its own, resize the master instead
+            std::shared_ptr<Workspace> TargetWorkspace = WM.Workspaces[GetWorkspaceFromContainer(WM.FocusedContainer)];
+            if (Direction == LEFT || Direction == RIGHT) {
+                TargetWorkspace->MasterRatio = std::clamp(TargetWorkspace->MasterRatio + ((Direction == RIGHT) ? RESIZE_INCREMEMNT : -RESIZE_INCREMEMNT), 0.05f, 0.95f);
+                UpdateWindowSplitsRecursively(TargetWorkspace->RootContainer);
             }
+        } else { // Tiling Logic
+            std::shared_ptr<Container> ResizedContainer = ResizeContainerInDirection(WM.FocusedContainer, Direction);
+            if (ResizedContainer != nullptr) { UpdateWindowSplitsRecursively(ResizedContainer); }
         }
     } 
 }
 
-void KillWindow(xcb_window_t Window) {
-    if (DoesWindowSupportProtocol(Window, WM.ProtocolsContainer.DeleteWindow)) {
-        std::cout << "Soft killing window: " << Window << std::endl;
-        xcb_client_message_event_t Event;
-        std::memset(&Event, 0, sizeof(Event));
-        Event.response_type = XCB_CLIENT_MESSAGE;
-        Event.window = Window;
-        Event.type = WM.ProtocolsContainer.Protocols;
-        Event.format = 32;
-        Event.data.data32[0] = WM.ProtocolsContainer.DeleteWindow;
-        Event.data.data32[1] = XCB_CURRENT_TIME;
-
-        xcb_send_event(WM.Connection, false, Window, XCB_EVENT_MASK_NO_EVENT, (const char*)&Event);
-        xcb_flush(WM.Connection);
+bool ParseDirection(const std::string &Arguments, WindowSegment &Direction) {
+    if (Arguments == "Left") { Direction = LEFT; } else if (Arguments == "Right") { Direction = RIGHT; } else if (Arguments == "Up") { Direction = UP; } else if (Arguments == "Down") { Direction = DOWN; } else {
+        std::cerr << "Unknown direction: " << Arguments << std::endl;
+        return false;
+    }
+    return true;
+}
+
+WindowSegment GetOppositeDirection(WindowSegment Direction) {
+    switch (Direction) {
+        case LEFT: { return RIGHT; }
+        case RIGHT: { return LEFT; }
+        case UP: { return DOWN; }
+        case DOWN: { return UP; }
+    }
+    return Direction;
+}
+
+/* Where a directional command lands, Container is nullptr if it's an empty monitor, Monitor is only set if it's on another monitor */
+struct DirectionalTarget {
+    std::shared_ptr<struct Container> Container = nullptr;
+    std::shared_ptr<struct Monitor> Monitor = nullptr;
+};
+
+/* Looks up the neighbour of the focused window in the spatial index of its monitor, hopping to the next monitor over if there's nothing left on this one */
+bool GetDirectionalTarget(WindowSegment Direction, DirectionalTarget &Target) {
+    if (WM.FocusedContainer == nullptr || WM.FocusedContainer->IndexedMonitor == nullptr) {
+        std::cerr << "Focused window isn't tiled on a monitor, so has no neighbours" << std::endl;
+        return false;
+    }
+
+    std::shared_ptr<Monitor> FromMonitor = WM.FocusedContainer->IndexedMonitor;
+    Geometry Rect = FromMonitor->Index.Rects[WM.FocusedContainer];
+    int32_t Edge, SpanStart, SpanEnd;
+    switch (Direction) {
+        case RIGHT: { Edge = Rect.X + Rect.Width; break; }
+        case LEFT: { Edge = Rect.X; break; }
+        case DOWN: { Edge = Rect.Y + Rect.Height; break; }
+        case UP: { Edge = Rect.Y; break; }
+    }
+    GetPerpendicularSpan(Rect, Direction, SpanStart, SpanEnd);
+
+    Target.Container = SearchSpatialIndex_PossibleNullptr(FromMonitor->Index, Direction, Edge, SpanStart, SpanEnd, WM.FocusedContainer);
+    if (Target.Container != nullptr) { return true; }
+
+    Target.Monitor = GetMonitorInDirection_PossibleNullptr(FromMonitor, Direction);
+    if (Target.Monitor == nullptr) {
+        std::cout << "Nothing in that direction" << std::endl;
+        return false;
+    }
+    Target.Container = GetEntryContainer_PossibleNullptr(Target.Monitor, Direction, SpanStart, SpanEnd);
+    return true;
+}
+
+/* Keeps the cursor on the monitor that keyboard navigation moved to, as the cursor decides which monitor is active */
+void WarpCursorToTarget(const DirectionalTarget &Target) {
+    int32_t X = Target.Monitor->X + (Target.Monitor->Width / 2);
+    int32_t Y = Target.Monitor->Y + (Target.Monitor->Height / 2);
+    if (Target.Container != nullptr && Target.Container->IndexedMonitor != nullptr) {
+        Geometry Rect = Target.Container->IndexedMonitor->Index.Rects[Target.Container];
+        X = Rect.X + (Rect.Width / 2);
+        Y = Rect.Y + (Rect.Height / 2);
+    }
+    xcb_warp_pointer(WM.Connection, XCB_NONE, WM.Screen->root, 0, 0, 0, 0, X, Y);
+    FlushConnection();
+    UpdateCursorPosition(X, Y);
+}
+
+void FocusInDirection(WindowSegment Direction) {
+    DirectionalTarget Target;
+    if (!GetDirectionalTarget(Direction, Target)) { return; }
+    if (Target.Container != nullptr) { FocusContainer(Target.Container); }
+    if (Target.Monitor != nullptr) { WarpCursorToTarget(Target); }
+}
+
+/* Takes a tiled container out of its workspace's tree and puts it beside Entry, on the given side. Without an Entry it takes over an empty tree, or lands beside the window
+focused there last, as a workspace can have a tree with nothing of it in the spatial index. False if a fullscreened window is in the way, then nothing was changed */
+bool MoveContainerBetweenTrees(std::shared_ptr<Container> Moving, std::shared_ptr<Workspace> SourceWorkspace, std::shared_ptr<Workspace> DestinationWorkspace, std::shared_ptr<Container> Entry, WindowSegment Side, std::shared_ptr<Container> &PromotionContainer) {
+    if (SourceWorkspace->FullscreenContainer == Moving) {
+        std::cerr << "Cannot move a fullscreened window" << std::endl;
+        return false;
+    }
+    if (DestinationWorkspace != SourceWorkspace && DestinationWorkspace->FullscreenContainer != nullptr) {
+        std::cerr << "Cannot move a window onto a workspace with a fullscreened window, it would be hidden underneath it" << std::endl;
+        return false;
+    }
+
+    PromotionContainer = DetachContainerFromTree(Moving, SourceWorkspace);
+    if (Entry != nullptr) {
+        InsertContainerBeside(Entry, Moving, Side, DestinationWorkspace);
+    } else if (DestinationWorkspace->RootContainer == nullptr) {
+        DestinationWorkspace->RootContainer = Moving;
+    } else {
+        std::shared_ptr<Container> LastFocused = DestinationWorkspace->FocusHistory;
+        if (LastFocused == nullptr || LastFocused == Moving || LastFocused->Value->Floating) { LastFocused = GetShallowestContainer(DestinationWorkspace->RootContainer); }
+        InsertContainerBeside(LastFocused, Moving, Side, DestinationWorkspace);
+    }
+    if (SourceWorkspace != DestinationWorkspace) {
+        UnlinkFocusHistory(Moving, SourceWorkspace);
+        LinkFocusHistory(Moving, DestinationWorkspace, true);
+    }
+    return true;
+}
+
+/* Moves the focused window into the tree next to its neighbour, or onto the neighbouring monitor */
+void MoveInDirection(WindowSegment Direction) {
+    DirectionalTarget Target;
+    if (!GetDirectionalTarget(Direction, Target)) { return; }
+
+    std::shared_ptr<Container> Moving = WM.FocusedContainer;
+    std::shared_ptr<Workspace> SourceWorkspace = WM.Workspaces[GetWorkspaceFromContainer(Moving)];
+    std::shared_ptr<Workspace> DestinationWorkspace = WM.Workspaces[(Target.Container != nullptr) ? GetWorkspaceFromContainer(Target.Container) : GetActiveWorkspaceEnsureValid(Target.Monitor)];
+
+    // Coming from another monitor, it lands on the near side of the entry window
+    std::shared_ptr<Container> PromotionContainer = nullptr;
+    if (!MoveContainerBetweenTrees(Moving, SourceWorkspace, DestinationWorkspace, Target.Container, (Target.Monitor != nullptr) ? GetOppositeDirection(Direction) : Direction, PromotionContainer)) { return; }
+
+    if (PromotionContainer != nullptr) { UpdateWindowSplitsRecursively(PromotionContainer); }
+    UpdateWindowSplitsRecursively((Moving->Parent != nullptr) ? Moving->Parent : Moving);
+    if (SourceWorkspace != DestinationWorkspace) {
+        SourceWorkspace->ClientsChanged = true;
+        DestinationWorkspace->ClientsChanged = true;
+        RestackWorkspace(SourceWorkspace);
+        RestackWorkspace(DestinationWorkspace);
+    }
+    if (Target.Monitor != nullptr) {
+        Target.Container = Moving;
+        WarpCursorToTarget(Target);
+    }
+}
+
+/* Swaps the windows of the focused container and its neighbour, the containers stay where they are in their trees */
+void SwapInDirection(WindowSegment Direction) {
+    DirectionalTarget Target;
+    if (!GetDirectionalTarget(Direction, Target)) { return; }
+    if (Target.Container == nullptr) { // Nothing to swap with on an empty or fullscreened monitor, MoveInDirection lands it there or refuses
+        MoveInDirection(Direction);
+        return;
+    }
+
+    std::shared_ptr<Workspace> SourceWorkspace = WM.Workspaces[GetWorkspaceFromContainer(WM.FocusedContainer)];
+    std::shared_ptr<Workspace> DestinationWorkspace = WM.Workspaces[GetWorkspaceFromContainer(Target.Container)];
+    if (SourceWorkspace->FullscreenContainer == WM.FocusedContainer || DestinationWorkspace->FullscreenContainer == Target.Container) {
+        std::cerr << "Cannot swap a fullscreened window" << std::endl;
+        return;
+    }
+
+    std::shared_ptr<Container> PreviousContainer = WM.FocusedContainer;
+    std::swap(PreviousContainer->Value, Target.Container->Value);
+    std::swap(PreviousContainer->Tabs, Target.Container->Tabs); // Tabs go with the window that's shown
+    FocusContainer(Target.Container); // Focus stays with the window
+    UpdateWindowToCurrentSplits(PreviousContainer);
+    UpdateWindowToCurrentSplits(Target.Container);
+    if (SourceWorkspace != DestinationWorkspace) {
+        SourceWorkspace->ClientsChanged = true;
+        DestinationWorkspace->ClientsChanged = true;
+        RestackWorkspace(SourceWorkspace);
+        RestackWorkspace(DestinationWorkspace);
+    }
+    if (Target.Monitor != nullptr) { WarpCursorToTarget(Target); }
+}
+
+/* Moves the focused container, tabs and all, into another workspace's tree without unmapping it. Only the subtrees it left and joined are laid out again, and the client just sees a configure */
+void TransplantActiveWindow(unsigned int DestinationIndex) {
+    if (WM.FocusedContainer == nullptr) {
+        std::cerr << "Focused window does not exist, cannot move it" << std::endl;
+        return;
+    }
+    std::shared_ptr<Container> Moving = WM.FocusedContainer;
+    int SourceIndex = GetWorkspaceFromContainer(Moving);
+    if (SourceIndex == -1 || SourceIndex == static_cast<int>(DestinationIndex)) { return; }
+    std::shared_ptr<Workspace> SourceWorkspace = WM.Workspaces[SourceIndex];
+    if (SourceWorkspace->FullscreenContainer == Moving) {
+        std::cerr << "Cannot move a fullscreened window" << std::endl;
+        return;
+    }
+    TraceScope Scope("TransplantActiveWindow", "layout");
+    EnsureValidWorkspacesBetweenIndicesInclusive(WM.Workspaces.size(), DestinationIndex);
+    std::shared_ptr<Workspace> DestinationWorkspace = WM.Workspaces[DestinationIndex];
+    std::shared_ptr<Monitor> DestinationMonitor = GetMonitorFromWorkspace_PossibleNullptr(DestinationIndex);
+
+    std::shared_ptr<Container> PromotionContainer = nullptr;
+    if (Moving->Value->Floating) { // Keeps its position and size, relative to whichever monitor it ends up on
+        SourceWorkspace->FloatingContainers.erase(std::remove(SourceWorkspace->FloatingContainers.begin(), SourceWorkspace->FloatingContainers.end(), Moving), SourceWorkspace->FloatingContainers.end());
+        DestinationWorkspace->FloatingContainers.push_back(Moving);
+    } else {
+        PromotionContainer = DetachContainerFromTree(Moving, SourceWorkspace);
+        UnindexContainer(Moving);
+        if (DestinationWorkspace->RootContainer == nullptr) {
+            DestinationWorkspace->RootContainer = Moving;
+        } else if (GetWorkspaceLayout(DestinationWorkspace).Insertion == SPLIT_SHALLOWEST && DestinationMonitor != nullptr) {
+            std::shared_ptr<Container> Shallowest = GetShallowestContainer(DestinationWorkspace->RootContainer);
+            LayoutRect Area = GetContainerArea(Shallowest, DestinationMonitor);
+            InsertContainerBeside(Shallowest, Moving, (Area.Width >= Area.Height) ? RIGHT : DOWN, DestinationWorkspace);
+        } else { // There's no focused window on the destination to split, same as a window a rule sends there
+            InsertContainerBeside(GetShallowestContainer(DestinationWorkspace->RootContainer), Moving, RIGHT, DestinationWorkspace);
+        }
+    }
+    UnlinkFocusHistory(Moving, SourceWorkspace);
+    LinkFocusHistory(Moving, DestinationWorkspace, true); // So it has focus again when its new workspace is shown
+    std::cout << "Moved window " << Moving->Value->Window << " from workspace " << SourceIndex << " to workspace " << DestinationIndex << std::endl;
+
+    if (PromotionContainer != nullptr) { UpdateWindowSplitsRecursively(PromotionContainer); }
+    if (Moving->Value->Floating) {
+        UpdateWindowToCurrentSplits(Moving);
     } else {
-        std::cout << "Hard killing window: " << Window << std::endl;
-        xcb_kill_client(WM.Connection, Window);
-        xcb_flush(WM.Connection);
+        UpdateWindowSplitsRecursively((Moving->Parent != nullptr) ? Moving->Parent : Moving);
     }
+    SourceWorkspace->ClientsChanged = true;
+    DestinationWorkspace->ClientsChanged = true;
+    RestackWorkspace(SourceWorkspace);
+    RestackWorkspace(DestinationWorkspace);
+    NotifyWindowChange(Moving->Value->Window, "moved", DestinationIndex);
+
+    if (DestinationMonitor == nullptr) { // Went out of sight, so focus stays behind with the window focused before it
+        if (SourceWorkspace->FocusHistory != nullptr) {
+            FocusContainer(SourceWorkspace->FocusHistory);
+        } else {
+            WM.FocusedContainer = nullptr;
+        }
+        ThrottleWorkspace(DestinationIndex);
+    }
+}
+
+/* Moves the focused window onto the workspace shown on the neighbouring monitor, the cursor follows it so it keeps focus */
+void TransplantActiveWindowToMonitor(WindowSegment Direction) {
+    if (WM.FocusedContainer == nullptr) { return; }
+    std::shared_ptr<Monitor> SourceMonitor = GetMonitorFromWorkspace_PossibleNullptr(GetWorkspaceFromContainer(WM.FocusedContainer));
+    DirectionalTarget Target;
+    Target.Monitor = (SourceMonitor != nullptr) ? GetMonitorInDirection_PossibleNullptr(SourceMonitor, Direction) : nullptr;
+    if (Target.Monitor == nullptr) {
+        std::cout << "No monitor in that direction" << std::endl;
+        return;
+    }
+
+    Target.Container = WM.FocusedContainer;
+    TransplantActiveWindow(GetActiveWorkspaceEnsureValid(Target.Monitor));
+    WarpCursorToTarget(Target);
+}
+
+void KillWindow(xcb_window_t Window) {
+    RequestWindowProperties(Window, [Window](const WindowProperties &Properties) {
+        if (std::find(Properties.Protocols.begin(), Properties.Protocols.end(), WM.ProtocolsContainer.DeleteWindow) != Properties.Protocols.end()) {
+            std::cout << "Soft killing window: " << Window << std::endl;
+            xcb_client_message_event_t Event;
+            std::memset(&Event, 0, sizeof(Event));
+            Event.response_type = XCB_CLIENT_MESSAGE;
+            Event.window = Window;
+            Event.type = WM.ProtocolsContainer.Protocols;
+            Event.format = 32;
+            Event.data.data32[0] = WM.ProtocolsContainer.DeleteWindow;
+            Event.data.data32[1] = XCB_CURRENT_TIME;
+
+            DropWindowOnError(xcb_send_event(WM.Connection, false, Window, XCB_EVENT_MASK_NO_EVENT, (const char*)&Event), Window);
+            FlushConnection();
+        } else {
+            std::cout << "Hard killing window: " << Window << std::endl;
+            xcb_kill_client(WM.Connection, Window);
+            FlushConnection();
+        }
+    }, FETCH_PROTOCOLS);
 }
 
 void ExitWM() {
-    free(WM.Keysyms);
+    for (auto &Process: WarmPool) { kill(Process.Pid, SIGTERM); } // Never shown, so nobody would miss them
+    while (!ThrottledProcesses.empty()) { ResumeProcess(ThrottledProcesses.begin()->first); } // Nothing would resume them after us
+    if (Snapshot != nullptr) { shm_unlink(Runtime.Settings.StateSnapshot.c_str()); } // Readers that have it mapped keep their copy
+    xcb_key_symbols_free(WM.Keysyms);
     xcb_disconnect(WM.Connection);
 }
 
@@ -801,53 +3217,252 @@ void SetWorkspaceToMonitor(unsigned int TargetWorkspace, std::shared_ptr<Monitor
         std::cout << "Swapping workspaces, set Previous monitor from workspace " << TargetMonitor << " to workspace " << PreviousWorkspace << std::endl;
     }
     
-    if (WM.Workspaces[PreviousWorkspace]->RootContainer != nullptr) {
-        UpdateWindowSplitsRecursively(WM.Workspaces[PreviousWorkspace]->RootContainer);
-    }
-    for (auto FloatingContainer: WM.Workspaces[PreviousWorkspace]->FloatingContainers) {
-        UpdateWindowToCurrentSplits(FloatingContainer);
-    }
+    ResumeWorkspace(TargetWorkspace);
+    UpdateWorkspaceSplits(PreviousWorkspace);
     std::cout << "Moved previous workspace " << PreviousWorkspace << std::endl;
+    UpdateWorkspaceSplits(TargetWorkspace);
+    if (PreviousMonitor == nullptr && PreviousWorkspace != TargetWorkspace) { ThrottleWorkspace(PreviousWorkspace); } // Otherwise it's still shown, on the monitor we robbed
 
-    if (WM.Workspaces[TargetWorkspace]->RootContainer != nullptr) {
-        UpdateWindowSplitsRecursively(WM.Workspaces[TargetWorkspace]->RootContainer);
-    }
-    for (auto FloatingContainer: WM.Workspaces[TargetWorkspace]->FloatingContainers) {
-        UpdateWindowToCurrentSplits(FloatingContainer);
+    // Focus goes back to the window the workspace had focused last, rather than staying on one that was just hidden
+    if (WM.Workspaces[TargetWorkspace]->FocusHistory != nullptr) {
+        FocusContainer(WM.Workspaces[TargetWorkspace]->FocusHistory);
+    } else if (WM.FocusedContainer != nullptr && GetMonitorFromWorkspace_PossibleNullptr(GetWorkspaceFromContainer(WM.FocusedContainer)) == nullptr) {
+        WM.FocusedContainer = nullptr;
     }
 
     std::cout << "Set Monitor: " << TargetMonitor << ", to workspace: " << TargetMonitor->ActiveWorkspace << " (should be the same as " << TargetWorkspace << ")" << std::endl;
 }
 
+void SetWorkspaceLayout(unsigned int TargetWorkspace, const std::string &LayoutName) {
+    auto Found = Layouts.find(LayoutName);
+    if (Found == Layouts.end()) {
+        std::cerr << "No layout called " << LayoutName << std::endl;
+        return;
+    }
+
+    std::shared_ptr<Workspace> Workspace = WM.Workspaces[TargetWorkspace];
+    Workspace->Layout = LayoutName;
+    std::cout << "Set workspace " << TargetWorkspace << " to layout " << LayoutName << std::endl;
+    if (Workspace->RootContainer == nullptr) { return; }
+
+    if (Found->second.Insertion != SPLIT_FOCUSED) { // The tree the user built up isn't needed, start the layout off balanced
+        std::shared_ptr<Monitor> Monitor = GetMonitorFromWorkspace_PossibleNullptr(TargetWorkspace);
+        RebalanceTree(Workspace, GetTilingArea(Monitor != nullptr ? Monitor : GetActiveMonitor()));
+    }
+    UpdateWindowSplitsRecursively(Workspace->RootContainer);
+}
+
+/* Puts a window into or out of fullscreen on its workspace. Only one window per workspace can be fullscreen, so a new one replaces the old one */
+void SetContainerFullscreen(std::shared_ptr<Container> TargetContainer, bool Fullscreen) {
+    int WorkspaceInt = GetWorkspaceFromContainer(TargetContainer);
+    if (WorkspaceInt == -1) {
+        std::cerr << "Could not find the workspace of container " << TargetContainer << ", cannot change its fullscreen state" << std::endl;
+        return;
+    }
+    std::shared_ptr<Workspace> TargetWorkspace = WM.Workspaces[WorkspaceInt];
+    if ((TargetWorkspace->FullscreenContainer == TargetContainer) == Fullscreen) { return; }
+
+    if (Fullscreen) {
+        std::cout << "Toggling fullscreen for Window: " << TargetContainer->Value->Window << std::endl;
+        if (TargetWorkspace->FullscreenContainer != nullptr) { SetWindowFullscreenHints(TargetWorkspace->FullscreenContainer->Value->Window, false); }
+        TargetWorkspace->FullscreenContainer = TargetContainer;
+        SetWindowFullscreenHints(TargetContainer->Value->Window, true);
+        UpdateWindowToCurrentSplits(TargetContainer); // Everything else is covered, so it stays where it is
+    } else {
+        std::cout << "Untoggling fullscreen for Workspace: " << WorkspaceInt << std::endl;
+        TargetWorkspace->FullscreenContainer = nullptr;
+        SetWindowFullscreenHints(TargetContainer->Value->Window, false);
+        UpdateWindowToCurrentSplits(TargetContainer);
+        UpdateWorkspaceSplits(WorkspaceInt); // Catch up on everything that changed underneath it
+    }
+    RestackWorkspace(TargetWorkspace);
+}
+
 void ToggleFullscreen() {
     if (WM.FocusedContainer) {
-        int WorkspaceInt = GetWorkspaceAndContainerFromWindow_PossibleNullptr(WM.FocusedContainer->Value->Window)->Workspace;
-        std::shared_ptr<Workspace> TargetWorkspace = WM.Workspaces[WorkspaceInt];
+        std::shared_ptr<Workspace> TargetWorkspace = WM.Workspaces[GetWorkspaceFromContainer(WM.FocusedContainer)];
         if (TargetWorkspace->FullscreenContainer != nullptr) { // Untoggle fullscreen window
-            std::cout << "Untoggling fullscreen for Workspace: " << WorkspaceInt << std::endl;
-            auto TargetContainer = TargetWorkspace->FullscreenContainer;
-            TargetWorkspace->FullscreenContainer = nullptr;
-            UpdateWindowToCurrentSplits(TargetContainer);
+            SetContainerFullscreen(TargetWorkspace->FullscreenContainer, false);
         } else { // Fullscreen the focused window
-            std::cout << "Toggling fullscreen for Window: " << WM.FocusedContainer->Value->Window << std::endl;
-            TargetWorkspace->FullscreenContainer = WM.FocusedContainer;
-            std::cout << "Set workspace " << WorkspaceInt << " fullscreen container to " << TargetWorkspace->FullscreenContainer << "(Should be same as " << WM.FocusedContainer << ")" << std::endl; 
-            SendWindowToFront(WM.FocusedContainer->Value->Window);
-            UpdateWindowToCurrentSplits(WM.FocusedContainer);
+            SetContainerFullscreen(WM.FocusedContainer, true);
         }
     } else {
         std::cerr << "No focused container to fullscreen / unfullscreen" << std::endl;
     }
 }
 
+/* Folds the split the focused window is in into a tabbed container that shows one window at a time, or spreads a tabbed container back out into splits.
+A lone window becomes a tabbed container of one, which new windows then join */
+void ToggleTabbed() {
+    if (WM.FocusedContainer == nullptr || WM.FocusedContainer->Value->Floating) { return; }
+    std::shared_ptr<Container> TabbedContainer = WM.FocusedContainer;
+    int WorkspaceIndex = GetWorkspaceFromContainer(TabbedContainer);
+    if (WorkspaceIndex == -1) { return; }
+    std::shared_ptr<Workspace> TargetWorkspace = WM.Workspaces[WorkspaceIndex];
+    if (TargetWorkspace->FullscreenContainer != nullptr) {
+        std::cerr << "Cannot change tabs while a window is fullscreened" << std::endl;
+        return;
+    }
+
+    if (!TabbedContainer->Tabs.empty()) { // Each hidden tab gets its own container again, split off after the one before it
+        std::vector<std::shared_ptr<Window>> Tabs = TabbedContainer->Tabs;
+        TabbedContainer->Tabs.clear();
+        std::shared_ptr<Container> Previous = TabbedContainer;
+        std::shared_ptr<Container> Subtree = TabbedContainer;
+        std::vector<xcb_window_t> Shown;
+        for (auto &Tab: Tabs) {
+            if (Tab == TabbedContainer->Value) { continue; }
+            std::shared_ptr<Container> NewContainer = std::make_shared<Container>();
+            NewContainer->Direction = NONE;
+            NewContainer->Value = Tab;
+            InsertContainerBeside(Previous, NewContainer, RIGHT, TargetWorkspace);
+            LinkFocusHistory(NewContainer, TargetWorkspace, false);
+            if (Subtree == TabbedContainer) { Subtree = TabbedContainer->Parent; }
+            Previous = NewContainer;
+            xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, Tab->Window, WM.ProtocolsContainer.NetWmState, XCB_ATOM_ATOM, 32, 0, nullptr);
+            xcb_change_window_attributes(WM.Connection, Tab->Window, XCB_CW_BORDER_PIXEL, &Runtime.Settings.InActiveTiledWindowBorderColour);
+            Shown.push_back(Tab->Window);
+        }
+
+        std::cout << "Split " << Shown.size() + 1 << " tabs back out" << std::endl;
+        TargetWorkspace->ClientsChanged = true;
+        UpdateWindowSplitsRecursively(Subtree);
+        CommitPendingGeometry(); // So the windows are mapped at their final size
+        for (xcb_window_t Window: Shown) { DropWindowOnError(xcb_map_window(WM.Connection, Window), Window); }
+        RestackWorkspace(TargetWorkspace);
+        FlushConnection();
+        return;
+    }
+
+    std::shared_ptr<Container> SplitContainer = TabbedContainer->Parent;
+    if (SplitContainer == nullptr) {
+        TabbedContainer->Tabs.push_back(TabbedContainer->Value);
+        std::cout << "Window " << TabbedContainer->Value->Window << " is now a tabbed container" << std::endl;
+        return;
+    }
+
+    // Every window under the split becomes a tab, in the order they were tiled
+    for (auto &Leaf: GetTiledContainersInOrder(SplitContainer)) {
+        if (Leaf == TabbedContainer) {
+            TabbedContainer->Tabs.push_back(TabbedContainer->Value);
+            continue;
+        }
+        if (Leaf->Tabs.empty()) {
+            TabbedContainer->Tabs.push_back(Leaf->Value);
+        } else { // Already tabbed, its hidden tabs stay hidden
+            TabbedContainer->Tabs.insert(TabbedContainer->Tabs.end(), Leaf->Tabs.begin(), Leaf->Tabs.end());
+        }
+        HideTab(Leaf->Value);
+        UnindexContainer(Leaf);
+        if (DraggedWindow == Leaf) { DraggedWindow = nullptr; }
+        UnlinkFocusHistory(Leaf, TargetWorkspace);
+        DetachContainerFromTree(Leaf, TargetWorkspace);
+    }
+
+    std::cout << "Folded " << TabbedContainer->Tabs.size() << " windows into a tabbed container" << std::endl;
+    TargetWorkspace->ClientsChanged = true;
+    UpdateWindowToCurrentSplits(TabbedContainer); // It has the whole area of the split now
+    RestackWorkspace(TargetWorkspace);
+    FlushConnection();
+}
+
+/* Shows the next or previous tab of the focused container, only the two windows that swap are touched */
+void CycleTab(int Offset) {
+    if (WM.FocusedContainer == nullptr || WM.FocusedContainer->Tabs.size() < 2) { return; }
+    std::vector<std::shared_ptr<Window>> &Tabs = WM.FocusedContainer->Tabs;
+    int Count = Tabs.size();
+    int Index = std::find(Tabs.begin(), Tabs.end(), WM.FocusedContainer->Value) - Tabs.begin();
+    SelectTab(WM.FocusedContainer, Tabs[((Index + Offset) % Count + Count) % Count]);
+}
+
+// ! EWMH
+/* Advertises the WM to clients that look for an EWMH compliant one, the rest of the root properties follow from PublishEWMH */
+void SetupEWMH() {
+    WM.Published.CheckWindow = xcb_generate_id(WM.Connection);
+    xcb_create_window(WM.Connection, XCB_COPY_FROM_PARENT, WM.Published.CheckWindow, WM.Screen->root, -1, -1, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, 0, nullptr);
+    xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Published.CheckWindow, WM.ProtocolsContainer.NetSupportingWmCheck, XCB_ATOM_WINDOW, 32, 1, &WM.Published.CheckWindow);
+    xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Published.CheckWindow, WM.ProtocolsContainer.NetWmName, WM.ProtocolsContainer.Utf8String, 8, strlen("exert"), "exert");
+    xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Screen->root, WM.ProtocolsContainer.NetSupportingWmCheck, XCB_ATOM_WINDOW, 32, 1, &WM.Published.CheckWindow);
+
+    xcb_atom_t Supported[] = {
+        WM.ProtocolsContainer.NetSupported, WM.ProtocolsContainer.NetSupportingWmCheck, WM.ProtocolsContainer.NetWmName, WM.ProtocolsContainer.NetClientList,
+        WM.ProtocolsContainer.NetActiveWindow, WM.ProtocolsContainer.NetNumberOfDesktops, WM.ProtocolsContainer.NetDesktopNames, WM.ProtocolsContainer.NetCurrentDesktop,
+        WM.ProtocolsContainer.NetWmState, WM.ProtocolsContainer.NetWmStateFullscreen, WM.ProtocolsContainer.NetWmStateHidden, WM.ProtocolsContainer.NetWmWindowType, WM.ProtocolsContainer.NetWmWindowTypeDialog,
+        WM.ProtocolsContainer.NetWmWindowTypeUtility, WM.ProtocolsContainer.NetWmWindowTypeSplash, WM.ProtocolsContainer.NetWmSyncRequest, WM.ProtocolsContainer.NetWmSyncRequestCounter,
+    };
+    xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Screen->root, WM.ProtocolsContainer.NetSupported, XCB_ATOM_ATOM, 32, sizeof(Supported) / sizeof(xcb_atom_t), Supported);
+    xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Screen->root, WM.ProtocolsContainer.NetActiveWindow, XCB_ATOM_WINDOW, 32, 1, &WM.Published.ActiveWindow);
+    std::cout << "Set up EWMH, check window: " << WM.Published.CheckWindow << std::endl;
+}
+
+/* Writes the root properties whose state changed during this iteration of the event loop, so bars and pagers can wait on PropertyNotify instead of polling.
+The client list is only re-walked for workspaces that gained or lost windows, everything else is compared against what was last written */
+void PublishEWMH() {
+    TraceScope Scope("PublishEWMH", "layout");
+    bool ClientsChanged = false;
+    for (auto &Workspace: WM.Workspaces) {
+        if (!Workspace->ClientsChanged) { continue; }
+        Workspace->PublishedClients.clear();
+        for (auto &TiledContainer: GetTiledContainersInOrder(Workspace->RootContainer)) {
+            if (TiledContainer->Tabs.empty()) { Workspace->PublishedClients.push_back(TiledContainer->Value->Window); }
+            for (auto &Tab: TiledContainer->Tabs) { Workspace->PublishedClients.push_back(Tab->Window); } // Hidden tabs are still clients, so taskbars can list them
+        }
+        for (auto &FloatingContainer: Workspace->FloatingContainers) { Workspace->PublishedClients.push_back(FloatingContainer->Value->Window); }
+        Workspace->ClientsChanged = false;
+        ClientsChanged = true;
+    }
+    if (ClientsChanged) {
+        std::vector<xcb_window_t> Clients;
+        for (auto &Workspace: WM.Workspaces) { Clients.insert(Clients.end(), Workspace->PublishedClients.begin(), Workspace->PublishedClients.end()); }
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Screen->root, WM.ProtocolsContainer.NetClientList, XCB_ATOM_WINDOW, 32, Clients.size(), Clients.data());
+    }
+
+    xcb_window_t ActiveWindow = (WM.FocusedContainer != nullptr) ? WM.FocusedContainer->Value->Window : XCB_NONE;
+    if (ActiveWindow != WM.Published.ActiveWindow) {
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Screen->root, WM.ProtocolsContainer.NetActiveWindow, XCB_ATOM_WINDOW, 32, 1, &ActiveWindow);
+        WM.Published.ActiveWindow = ActiveWindow;
+    }
+
+    if (WM.Workspaces.size() != WM.Published.Desktops) {
+        uint32_t Desktops = WM.Workspaces.size();
+        std::string Names;
+        for (uint32_t i = 0; i < Desktops; i++) { Names += std::to_string(i + 1) + '\0'; } // Named after the number keys that select them
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Screen->root, WM.ProtocolsContainer.NetNumberOfDesktops, XCB_ATOM_CARDINAL, 32, 1, &Desktops);
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Screen->root, WM.ProtocolsContainer.NetDesktopNames, WM.ProtocolsContainer.Utf8String, 8, Names.size(), Names.data());
+        WM.Published.Desktops = Desktops;
+    }
+
+    std::vector<uint32_t> CurrentDesktops;
+    for (auto &Monitor: WM.Monitors) { CurrentDesktops.push_back(Monitor->ActiveWorkspace); }
+    if (CurrentDesktops != WM.Published.CurrentDesktops) {
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Screen->root, WM.ProtocolsContainer.ExertCurrentDesktops, XCB_ATOM_CARDINAL, 32, CurrentDesktops.size(), CurrentDesktops.data());
+        WM.Published.CurrentDesktops = CurrentDesktops;
+    }
+
+    // The desktop of the monitor the cursor is on, as that's where keybinds act
+    int CurrentDesktop = (WM.Cursor.CurrentMonitor != nullptr) ? WM.Cursor.CurrentMonitor->ActiveWorkspace : -1;
+    if (CurrentDesktop != -1 && CurrentDesktop != WM.Published.CurrentDesktop) {
+        uint32_t Value = CurrentDesktop;
+        xcb_change_property(WM.Connection, XCB_PROP_MODE_REPLACE, WM.Screen->root, WM.ProtocolsContainer.NetCurrentDesktop, XCB_ATOM_CARDINAL, 32, 1, &Value);
+        WM.Published.CurrentDesktop = CurrentDesktop;
+    }
+}
+
 // ! EVENT LOOP FUNCTIONS
 void OnMotionNotify(xcb_generic_event_t* NextEvent) {
     static std::shared_ptr<Monitor> Monitor = nullptr;
+    xcb_motion_notify_event_t* Event = (xcb_motion_notify_event_t*)NextEvent;
+    if (Event->detail == XCB_MOTION_HINT) { // The cursor moved, but we aren't told where to until we ask
+        WM.Cursor.Stale = true;
+        return;
+    }
+    UpdateCursorPosition(Event->root_x, Event->root_y);
+
     if (DraggedWindow != nullptr) {
         if (Monitor == nullptr) {
-            Monitor = GetMonitorFromWorkspace_PossibleNullptr(GetWorkspaceAndContainerFromWindow_PossibleNullptr(DraggedWindow->Value->Window)->Workspace);
+            Monitor = GetMonitorFromWorkspace_PossibleNullptr(GetWorkspaceFromContainer(DraggedWindow));
+            if (Monitor == nullptr) { return; }
         }
-        xcb_motion_notify_event_t* Event = (xcb_motion_notify_event_t*)NextEvent;
         if (Repositioning) {
             DraggedWindow->Value->Position.X = std::clamp((float)(Event->root_x - Monitor->X) / Monitor->Width - InitialDraggingPosition.X, 0.0f, 1.0f - DraggedWindow->Value->Size.X);
             DraggedWindow->Value->Position.Y = std::clamp((float)(Event->root_y - Monitor->Y) / Monitor->Height - InitialDraggingPosition.Y, 0.0f, 1.0f - DraggedWindow->Value->Size.Y);
@@ -864,44 +3479,203 @@ void OnMotionNotify(xcb_generic_event_t* NextEvent) {
 }
 
 
+/* Size hints are cached from when the window was mapped, a client that changes them (eg. a terminal changing its font) gets them read again and is laid out with them */
+void OnPropertyNotify(const xcb_generic_event_t* NextEvent) {
+    xcb_property_notify_event_t* Event = (xcb_property_notify_event_t*)NextEvent;
+    if (Event->atom != XCB_ATOM_WM_NORMAL_HINTS || GetWorkspaceAndContainerFromWindow_PossibleNullptr(Event->window) == nullptr) { return; }
+    xcb_window_t HintedWindow = Event->window;
+    RequestWindowProperties(HintedWindow, [HintedWindow](const WindowProperties &Properties) {
+        auto Result = GetWorkspaceAndContainerFromWindow_PossibleNullptr(HintedWindow);
+        if (Result == nullptr) { return; } // Gone while they were read
+        std::shared_ptr<Window> TargetWindow = GetContainerWindow_PossibleNullptr(Result->Container, HintedWindow);
+        if (TargetWindow == nullptr) { return; }
+        std::cout << "Window " << HintedWindow << " changed its size hints" << std::endl;
+        TargetWindow->Hints = Properties.Hints;
+        if (Result->Container->Value == TargetWindow) { UpdateWindowToCurrentSplits(Result->Container); } // Nothing is sent if the fitted size didn't change, hidden tabs are fitted when they're shown
+    }, FETCH_HINTS);
+}
+
 void OnEnterNotify(const xcb_generic_event_t* NextEvent) {
     xcb_enter_notify_event_t* Event = (xcb_enter_notify_event_t*) NextEvent;
-    FocusContainer(GetWorkspaceAndContainerFromWindow_PossibleNullptr(Event->event)->Container);
+    UpdateCursorPosition(Event->root_x, Event->root_y);
+    if (Event->event == WM.Screen->root) { return; } // Only selected to track the cursor
+    auto Result = GetWorkspaceAndContainerFromWindow_PossibleNullptr(Event->event);
+    if (Result != nullptr) { FocusContainer(Result->Container); } // The window could have been dropped before its enter event was read
+}
+
+/* Tells the client its geometry without changing anything, from what we already know, so it stops waiting on a ConfigureNotify. Hidden tabs are told the geometry they were hidden at */
+void SendSyntheticConfigureNotify(std::shared_ptr<Window> TargetWindow, bool HiddenTab = false) {
+    Geometry Known;
+    auto Pending = PendingCommits.find(TargetWindow->Window);
+    if (TargetWindow->HasCommittedGeometry || HiddenTab) {
+        Known = TargetWindow->CommittedGeometry;
+    } else if (Pending != PendingCommits.end()) { // Not configured yet, but about to be
+        Known = Pending->second.To;
+    } else {
+        Known = GetWindowGeometry(TargetWindow);
+    }
+
+    xcb_configure_notify_event_t Event;
+    std::memset(&Event, 0, sizeof(Event));
+    Event.response_type = XCB_CONFIGURE_NOTIFY;
+    Event.event = TargetWindow->Window;
+    Event.window = TargetWindow->Window;
+    Event.above_sibling = XCB_NONE;
+    Event.x = Known.X;
+    Event.y = Known.Y;
+    Event.width = Known.Width;
+    Event.height = Known.Height;
+    Event.border_width = Known.BorderWidth;
+    Event.override_redirect = false;
+    DropWindowOnError(xcb_send_event(WM.Connection, false, TargetWindow->Window, XCB_EVENT_MASK_STRUCTURE_NOTIFY, (const char*)&Event), TargetWindow->Window);
+}
+
+/* Tiled windows are placed by the layout, so their requests are answered with where they already are. Floating windows get what they asked for */
+void OnConfigureRequest(const xcb_generic_event_t* NextEvent) {
+    xcb_configure_request_event_t* Event = (xcb_configure_request_event_t*)NextEvent;
+    auto Result = GetWorkspaceAndContainerFromWindow_PossibleNullptr(Event->window);
+    if (Result == nullptr) { // Not managed yet (eg. sizing itself before mapping), pass the request through as it is
+        std::vector<uint32_t> Values;
+        if (Event->value_mask & XCB_CONFIG_WINDOW_X) { Values.push_back(Event->x); }
+        if (Event->value_mask & XCB_CONFIG_WINDOW_Y) { Values.push_back(Event->y); }
+        if (Event->value_mask & XCB_CONFIG_WINDOW_WIDTH) { Values.push_back(Event->width); }
+        if (Event->value_mask & XCB_CONFIG_WINDOW_HEIGHT) { Values.push_back(Event->height); }
+        if (Event->value_mask & XCB_CONFIG_WINDOW_BORDER_WIDTH) { Values.push_back(Event->border_width); }
+        if (Event->value_mask & XCB_CONFIG_WINDOW_SIBLING) { Values.push_back(Event->sibling); }
+        if (Event->value_mask & XCB_CONFIG_WINDOW_STACK_MODE) { Values.push_back(Event->stack_mode); }
+        xcb_configure_window(WM.Connection, Event->window, Event->value_mask, Values.data());
+        return;
+    }
+
+    std::shared_ptr<Container> TargetContainer = Result->Container;
+    std::shared_ptr<Window> TargetWindow = GetContainerWindow_PossibleNullptr(TargetContainer, Event->window);
+    if (TargetWindow == nullptr) { return; }
+    if (TargetWindow != TargetContainer->Value) { // A hidden tab, it gets the shown tab's geometry when it's selected
+        SendSyntheticConfigureNotify(TargetWindow, true);
+        return;
+    }
+    std::shared_ptr<Monitor> Monitor = GetMonitorFromWorkspace_PossibleNullptr(Result->Workspace);
+    bool Fullscreen = (WM.Workspaces[Result->Workspace]->FullscreenContainer == TargetContainer);
+    if (TargetWindow->Floating && !Fullscreen && Monitor != nullptr && DraggedWindow != TargetContainer) {
+        float BorderWidth = Runtime.Settings.FloatingWindowBorderSize;
+        if (Event->value_mask & XCB_CONFIG_WINDOW_WIDTH) { TargetWindow->Size.X = std::clamp((Event->width + (2*BorderWidth)) / Monitor->Width, 0.05f, 1.0f); }
+        if (Event->value_mask & XCB_CONFIG_WINDOW_HEIGHT) { TargetWindow->Size.Y = std::clamp((Event->height + (2*BorderWidth)) / Monitor->Height, 0.05f, 1.0f); }
+        if (Event->value_mask & XCB_CONFIG_WINDOW_X) { TargetWindow->Position.X = static_cast<float>(Event->x - Monitor->X) / Monitor->Width; }
+        if (Event->value_mask & XCB_CONFIG_WINDOW_Y) { TargetWindow->Position.Y = static_cast<float>(Event->y - Monitor->Y) / Monitor->Height; }
+        TargetWindow->Position.X = std::clamp(TargetWindow->Position.X, 0.0f, 1.0f - TargetWindow->Size.X);
+        TargetWindow->Position.Y = std::clamp(TargetWindow->Position.Y, 0.0f, 1.0f - TargetWindow->Size.Y);
+        std::cout << "Floating window " << TargetWindow->Window << " asked to be configured" << std::endl;
+        UpdateWindowToCurrentSplits(TargetContainer, Monitor);
+        if (PendingCommits.find(TargetWindow->Window) != PendingCommits.end()) { return; } // The real ConfigureNotify is on its way
+    }
+    SendSyntheticConfigureNotify(TargetWindow);
 }
 
 void OnMapRequest(const xcb_generic_event_t* NextEvent) {
     std::cout << "Map request recieved" << std::endl;
     xcb_map_request_event_t* Event = (xcb_map_request_event_t*)NextEvent;
-    MapWindowToWM(Event->window);
+    xcb_window_t Window = Event->window;
+    PendingMaps.insert(Window);
+    RequestWindowProperties(Window, [Window](const WindowProperties &Properties) {
+        if (PendingMaps.erase(Window) == 0) { return; } // Withdrawn or destroyed while its properties were read
+        if (AdoptWarmWindow(Window, Properties.Pid)) { return; }
+        MapWindowToWM(Window, false, true, &Properties);
+    });
 }
 
 void OnUnMapNotify(const xcb_generic_event_t* NextEvent) {
     xcb_map_request_event_t* Event = (xcb_map_request_event_t*)NextEvent;
+    PendingMaps.erase(Event->window);
     auto Result = GetWorkspaceAndContainerFromWindow_PossibleNullptr(Event->window);
     if (Result != nullptr) {
-        RemoveContainerFromWM(Result->Container, Result->Workspace);
+        std::shared_ptr<Window> UnmappedWindow = GetContainerWindow_PossibleNullptr(Result->Container, Event->window);
+        if (UnmappedWindow->IgnoreUnmaps > 0) { // We hid it as a tab
+            UnmappedWindow->IgnoreUnmaps--;
+            return;
+        }
+        RemoveWindowFromWM(Event->window);
     } // We don't error, as it can fail as unmap can be called on clients we haven't set up
 }
 
 void OnDestroyNotify(const xcb_generic_event_t* NextEvent) {
     xcb_map_request_event_t* Event = (xcb_map_request_event_t*)NextEvent;
-    auto Result = GetWorkspaceAndContainerFromWindow_PossibleNullptr(Event->window);
-    if (Result != nullptr) {
-        RemoveContainerFromWM(Result->Container, Result->Workspace);
+    PendingMaps.erase(Event->window);
+    if (Event->window == WindowToMove) { WindowToMove = XCB_NONE; } // Nothing to put down any more
+    ForgetWarmWindow(Event->window);
+    RemoveWindowFromWM(Event->window);
+}
+
+/* Removes a window that has disappeared under the WM, the same as if it had been destroyed */
+void ForgetWindow(xcb_window_t Window) {
+    ForgetWarmWindow(Window); // Warm windows aren't in any workspace
+    if (GetWorkspaceAndContainerFromWindow_PossibleNullptr(Window) != nullptr) {
+        std::cout << "Window " << Window << " no longer exists, dropping it" << std::endl;
+        RemoveWindowFromWM(Window);
+    }
+}
+
+void OnXError(const xcb_generic_event_t* NextEvent) {
+    const xcb_generic_error_t* Error = (const xcb_generic_error_t*)NextEvent;
+    std::cerr << "X error " << (int)Error->error_code << " from request " << (int)Error->major_code << "." << (int)Error->minor_code << " (sequence " << Error->full_sequence << ") on resource " << Error->resource_id << std::endl;
+    bool WindowIsGone = (Error->error_code == XCB_WINDOW || Error->error_code == XCB_DRAWABLE);
+
+    auto Found = ErrorHandlers.find(Error->full_sequence);
+    if (Found == ErrorHandlers.end()) { // Nobody asked about this request, but a client we manage could still have died under it
+        if (WindowIsGone) { ForgetWindow(Error->resource_id); }
+        return;
     }
+
+    ErrorHandler Handler = Found->second;
+    ErrorHandlers.erase(Found);
+    if (Handler.Handler) { Handler.Handler(Error); }
+    if (Handler.Window != XCB_NONE && WindowIsGone) { ForgetWindow(Handler.Window); }
 }
 
+/* The client set its sync counter, so it has drawn the last size it was sent and any change waiting behind it can go out */
+void OnSyncAlarmNotify(const xcb_generic_event_t* NextEvent) {
+    const xcb_sync_alarm_notify_event_t* Event = (const xcb_sync_alarm_notify_event_t*)NextEvent;
+    auto Found = SyncAlarms.find(Event->alarm);
+    if (Found == SyncAlarms.end()) { return; }
+
+    std::shared_ptr<Window> TargetWindow = Found->second;
+    int64_t CounterValue = (static_cast<int64_t>(Event->counter_value.hi) << 32) | Event->counter_value.lo;
+    if (TargetWindow->SyncRequestTime == 0 || CounterValue < TargetWindow->SyncValue) { return; } // Left over from an earlier request
+    TargetWindow->SyncRequestTime = 0;
+}
+
+/* _NET_WM_STATE client messages, data32[0] is the action and data32[1] / data32[2] are the states it applies to */
 void HandleFullScreenRequest(xcb_generic_event_t* NextEvent) {
-    xcb_client_message_event_t* event = (xcb_client_message_event_t*)NextEvent;
-    if (event->type == WM.ProtocolsContainer.NetWmState) {
-        if (event->data.data32[1] == WM.ProtocolsContainer.NetWmStateFullscreen || event->data.data32[2] == WM.ProtocolsContainer.NetWmStateFullscreen) {
-            std::cout << "fullscreen request for window " << event->window << std::endl; /*
-            uint32_t values[] = { XCB_STACK_MODE_ABOVE };
-            xcb_configure_window(WM.Connection, event->window, XCB_CONFIG_WINDOW_STACK_MODE, values);
-            xcb_flush(WM.Connection); */
+    xcb_client_message_event_t* Event = (xcb_client_message_event_t*)NextEvent;
+    if (Event->type != WM.ProtocolsContainer.NetWmState || Event->format != 32) { return; }
+    if (Event->data.data32[1] != WM.ProtocolsContainer.NetWmStateFullscreen && Event->data.data32[2] != WM.ProtocolsContainer.NetWmStateFullscreen) { return; }
+
+    auto Result = GetWorkspaceAndContainerFromWindow_PossibleNullptr(Event->window);
+    if (Result == nullptr) {
+        std::cerr << "Fullscreen request for window " << Event->window << " that we don't manage" << std::endl;
+        return;
+    }
+
+    // The container's fullscreen state belongs to the tab it shows, a hidden tab isn't fullscreen
+    std::shared_ptr<Window> Requester = GetContainerWindow_PossibleNullptr(Result->Container, Event->window);
+    if (Requester == nullptr) { return; }
+    bool Shown = (Requester == Result->Container->Value);
+    bool IsFullscreen = Shown && (WM.Workspaces[Result->Workspace]->FullscreenContainer == Result->Container);
+    bool Fullscreen;
+    switch (Event->data.data32[0]) {
+        case 0: { Fullscreen = false; break; } // _NET_WM_STATE_REMOVE
+        case 1: { Fullscreen = true; break; } // _NET_WM_STATE_ADD
+        case 2: { Fullscreen = !IsFullscreen; break; } // _NET_WM_STATE_TOGGLE
+        default: {
+            std::cerr << "Unknown _NET_WM_STATE action: " << Event->data.data32[0] << std::endl;
             return;
         }
     }
+    std::cout << "Fullscreen request for window " << Event->window << std::endl;
+    if (!Shown) {
+        if (!Fullscreen) { return; } // Already isn't
+        SelectTab(Result->Container, Requester); // Brought to the front, so it's the tab that goes fullscreen
+    }
+    SetContainerFullscreen(Result->Container, Fullscreen);
 }
 
 std::unordered_map<std::string, std::function<void(const std::string &Arguments, int Source)>> InternalCommand = { // Only used in on keypress hence why it is here
@@ -909,6 +3683,8 @@ std::unordered_map<std::string, std::function<void(const std::string &Arguments,
     {"ExitWM", [](const std::string &Arguments, int Source) { ExitWM(); }},
     {"SetFocusedMonitorToWorkspace", [](const std::string &Arguments, int Source){ SetWorkspaceToMonitor(std::stoi(Arguments), GetActiveMonitor()); }},
     {"ToggleFullscreen", [](const std::string &Arguments, int Source){ ToggleFullscreen(); }},
+    {"ToggleTabbed", [](const std::string &Arguments, int Source){ ToggleTabbed(); }},
+    {"CycleTab", [](const std::string &Arguments, int Source){ CycleTab((Arguments == "Previous") ? -1 : 1); }},
     {"ResizeActiveWindow", [](const std::string &Arguments, int Source) { if (Arguments == "Left") {ResizeActiveWindow(LEFT); } else if (Arguments == "Right") { ResizeActiveWindow(RIGHT); } else if (Arguments == "Up") { ResizeActiveWindow(UP); } else if (Arguments == "Down") {ResizeActiveWindow(DOWN); }}},
     {"MoveActiveWindow", [](const std::string &Arguments, int Source){ MoveActiveWindow(); }},
     {"ChangeActiveWindowSplitDirection", [](const std::string &Arguments, int Source){ ChangeActiveWindowSplitDirection(); }},
@@ -917,10 +3693,19 @@ std::unordered_map<std::string, std::function<void(const std::string &Arguments,
     {"MoveFloatingWindow", [](const std::string &Arguments, int Source) { if (Arguments == "Left") {MoveFloatingWindow(LEFT); } else if (Arguments == "Right") { MoveFloatingWindow(RIGHT); } else if (Arguments == "Up") { MoveFloatingWindow(UP); } else if (Arguments == "Down") {MoveFloatingWindow(DOWN); }}},
     {"DragFloatingWindow", [](const std::string &Arguments, int Source){ ChangeFloatingWindow(true); }},
     {"ResizeFloatingWindow", [](const std::string &Arguments, int Source){ ChangeFloatingWindow(false); }},
+    {"SetLayout", [](const std::string &Arguments, int Source){ SetWorkspaceLayout(GetActiveWorkspaceEnsureValid(GetActiveMonitor()), Arguments); }},
+    {"SetThrottle", [](const std::string &Arguments, int Source){ WM.Workspaces[GetActiveWorkspaceEnsureValid(GetActiveMonitor())]->Throttle = Arguments; std::cout << "Set the throttle of the active workspace to " << Arguments << std::endl; }},
+    {"FocusDirection", [](const std::string &Arguments, int Source) { WindowSegment Direction; if (ParseDirection(Arguments, Direction)) { FocusInDirection(Direction); }}},
+    {"SwapDirection", [](const std::string &Arguments, int Source) { WindowSegment Direction; if (ParseDirection(Arguments, Direction)) { SwapInDirection(Direction); }}},
+    {"DumpTrace", [](const std::string &Arguments, int Source) { DumpTrace(Arguments.empty() ? "/tmp/exert-trace.json" : Arguments); }},
+    {"MoveDirection", [](const std::string &Arguments, int Source) { WindowSegment Direction; if (ParseDirection(Arguments, Direction)) { MoveInDirection(Direction); }}},
+    {"MoveActiveWindowToWorkspace", [](const std::string &Arguments, int Source){ TransplantActiveWindow(std::stoi(Arguments)); }},
+    {"MoveActiveWindowToMonitor", [](const std::string &Arguments, int Source) { WindowSegment Direction; if (ParseDirection(Arguments, Direction)) { TransplantActiveWindowToMonitor(Direction); }}},
 };
 
 void OnBind(const xcb_generic_event_t* NextEvent, std::multimap<unsigned int, struct Keybind> Targetbinds, int Source) {
-    xcb_key_press_event_t* Event = (xcb_key_press_event_t*)NextEvent;
+    xcb_key_press_event_t* Event = (xcb_key_press_event_t*)NextEvent; // Button presses share the same layout
+    UpdateCursorPosition(Event->root_x, Event->root_y);
     xcb_keycode_t Keycode = Event->detail;
     auto TargetRange = Targetbinds.equal_range(Keycode);
     if (TargetRange.first != TargetRange.second) {
@@ -936,13 +3721,20 @@ void OnBind(const xcb_generic_event_t* NextEvent, std::multimap<unsigned int, st
                     auto Found = InternalCommand.find(CommandName);
                     if (Found != InternalCommand.end()) {
                         std::cout << "Executing Internal Command: " << CommandName << std::endl; 
+                        TraceScope Scope(Found->first.c_str(), "command");
                         Found->second(Arguments, Source);
                     } else {
                         std::cerr << "No matching function to call for: " << CommandName << std::endl;
                     }
-                } else if (fork() == 0) {
-                    std::cout << "Executing: " << Command << std::endl;
-                    execl("/bin/sh", "/bin/sh", "-c", Command.c_str(), (void *)NULL);
+                } else if (ClaimWarmWindow(Command)) {
+                    return;
+                } else {
+                    if (fork() == 0) {
+                        UnblockChildSignals();
+                        std::cout << "Executing: " << Command << std::endl;
+                        execl("/bin/sh", "/bin/sh", "-c", Command.c_str(), (void *)NULL);
+                    }
+                    if (Runtime.Settings.WarmPool.count(Command) > 0) { ReplenishWarmPool(); } // Nothing was warm yet, make sure the pool still fills up
                 }
                 return;
             }
@@ -952,8 +3744,16 @@ void OnBind(const xcb_generic_event_t* NextEvent, std::multimap<unsigned int, st
 
 /* MAIN FUNCTION CALLS */
 void StartupWM() {
-    const uint32_t Masks = XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_STRUCTURE_NOTIFY |  XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE;
-    xcb_change_window_attributes_checked(WM.Connection, WM.Screen->root, XCB_CW_EVENT_MASK, &Masks); std::cout << "Changed checked window attributes" << std::endl;
+    // Motion hints only send one event after the cursor moves, until it's queried again, which is enough to know when the cached cursor position is stale
+    const uint32_t Masks = XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_STRUCTURE_NOTIFY |  XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE
+    | XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_POINTER_MOTION_HINT;
+    TraceScope Scope("StartupWM", "reply");
+    XcbPointer<xcb_generic_error_t> Error(xcb_request_check(WM.Connection, xcb_change_window_attributes_checked(WM.Connection, WM.Screen->root, XCB_CW_EVENT_MASK, &Masks)));
+    if (Error) { // Only one client can select substructure redirect on the root
+        std::cerr << "Failed to select events on the root window, is another window manager running? [EXIT]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Changed checked window attributes" << std::endl;
     xcb_ungrab_button(WM.Connection, XCB_GRAB_ANY, WM.Screen->root, XCB_MOD_MASK_ANY);
     xcb_ungrab_key(WM.Connection, XCB_GRAB_ANY, WM.Screen->root, XCB_MOD_MASK_ANY); std::cout << "Reset all grabbed keys" << std::endl;
 
@@ -963,26 +3763,45 @@ void StartupWM() {
     for (const auto &Pair : Runtime.Mousebinds) {
         xcb_grab_button(WM.Connection, 0, WM.Screen->root, XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_POINTER_MOTION, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC, WM.Screen->root, XCB_NONE, Pair.first, Pair.second.Modifier);
     }
-    xcb_flush(WM.Connection); std::cout << "Starting up the WM" << std::endl;
+    SetupEWMH();
+    FlushConnection(); std::cout << "Starting up the WM" << std::endl;
+}
+
+/* Without the SYNC extension clients are resized as soon as the layout changes, like before */
+void InitialiseSync() {
+    TraceScope Scope("InitialiseSync", "reply");
+    const xcb_query_extension_reply_t* Extension = xcb_get_extension_data(WM.Connection, &xcb_sync_id);
+    if (!Extension || !Extension->present) {
+        std::cerr << "The X server doesn't have the SYNC extension, _NET_WM_SYNC_REQUEST is disabled" << std::endl;
+        return;
+    }
+    XcbPointer<xcb_sync_initialize_reply_t> Reply(xcb_sync_initialize_reply(WM.Connection, xcb_sync_initialize(WM.Connection, 3, 1), nullptr));
+    if (!Reply) {
+        std::cerr << "Failed to initialise the SYNC extension, _NET_WM_SYNC_REQUEST is disabled" << std::endl;
+        return;
+    }
+    SyncEventBase = Extension->first_event;
+    std::cout << "Initialised SYNC " << (int)Reply->major_version << "." << (int)Reply->minor_version << std::endl;
 }
 
 void InitialiseMonitors() {
+    TraceScope Scope("InitialiseMonitors", "reply");
     xcb_randr_get_screen_resources_current_cookie_t ResourcesCookie = xcb_randr_get_screen_resources_current(WM.Connection, WM.Screen->root);
-    xcb_randr_get_screen_resources_current_reply_t* ResourcesReply = xcb_randr_get_screen_resources_current_reply(WM.Connection, ResourcesCookie, nullptr);
+    XcbPointer<xcb_randr_get_screen_resources_current_reply_t> ResourcesReply(xcb_randr_get_screen_resources_current_reply(WM.Connection, ResourcesCookie, nullptr));
 
     if (!ResourcesReply) {
         std::cerr << "Failed to get screen resources! [EXIT]" << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    int NumberOfOutputs = xcb_randr_get_screen_resources_current_outputs_length(ResourcesReply);
-    xcb_randr_output_t* Outputs = xcb_randr_get_screen_resources_current_outputs(ResourcesReply);
+    int NumberOfOutputs = xcb_randr_get_screen_resources_current_outputs_length(ResourcesReply.get());
+    xcb_randr_output_t* Outputs = xcb_randr_get_screen_resources_current_outputs(ResourcesReply.get());
 
     for (int i = 0; i < NumberOfOutputs; i++) {
         xcb_randr_output_t Output = Outputs[i];
         
         xcb_randr_get_output_info_cookie_t InformationCookie = xcb_randr_get_output_info(WM.Connection, Output, XCB_CURRENT_TIME);
-        xcb_randr_get_output_info_reply_t* InformationReply = xcb_randr_get_output_info_reply(WM.Connection, InformationCookie, nullptr);
+        XcbPointer<xcb_randr_get_output_info_reply_t> InformationReply(xcb_randr_get_output_info_reply(WM.Connection, InformationCookie, nullptr));
 
         if (!InformationReply) {
             std::cerr << "Failed to get info for Output: " << Output << " [EXIT] " << std::endl;
@@ -991,43 +3810,73 @@ void InitialiseMonitors() {
 
         if (InformationReply->crtc != XCB_NONE) {
             xcb_randr_get_crtc_info_cookie_t CRTCCookie = xcb_randr_get_crtc_info(WM.Connection, InformationReply->crtc, XCB_CURRENT_TIME);
-            xcb_randr_get_crtc_info_reply_t* CRTCReply = xcb_randr_get_crtc_info_reply(WM.Connection, CRTCCookie, nullptr);
+            XcbPointer<xcb_randr_get_crtc_info_reply_t> CRTCReply(xcb_randr_get_crtc_info_reply(WM.Connection, CRTCCookie, nullptr));
 
             if (CRTCReply) {
                 std::shared_ptr<Monitor> NewMonitor = std::make_shared<Monitor>();
                 NewMonitor->Output = Output;
-                NewMonitor->Name = std::string((char*)xcb_randr_get_output_info_name(InformationReply), xcb_randr_get_output_info_name_length(InformationReply));
+                NewMonitor->Name = std::string((char*)xcb_randr_get_output_info_name(InformationReply.get()), xcb_randr_get_output_info_name_length(InformationReply.get()));
                 NewMonitor->X = CRTCReply->x;
                 NewMonitor->Y = CRTCReply->y;
                 NewMonitor->Width = CRTCReply->width;
                 NewMonitor->Height = CRTCReply->height;
 
+                xcb_randr_mode_info_t* Modes = xcb_randr_get_screen_resources_current_modes(ResourcesReply.get());
+                for (int j = 0; j < xcb_randr_get_screen_resources_current_modes_length(ResourcesReply.get()); j++) {
+                    if (Modes[j].id == CRTCReply->mode && Modes[j].htotal != 0 && Modes[j].vtotal != 0) {
+                        float VerticalTotal = Modes[j].vtotal;
+                        if (Modes[j].mode_flags & XCB_RANDR_MODE_FLAG_DOUBLE_SCAN) { VerticalTotal *= 2; }
+                        if (Modes[j].mode_flags & XCB_RANDR_MODE_FLAG_INTERLACE) { VerticalTotal /= 2; }
+                        NewMonitor->RefreshRate = Modes[j].dot_clock / (Modes[j].htotal * VerticalTotal);
+                    }
+                }
+
                 WM.Monitors.push_back(NewMonitor);
 
                 std::cout << "Name: " << NewMonitor->Name << ", Output: " << NewMonitor->Output << ", X: " << NewMonitor->X << ", Y: " 
-                << NewMonitor->Y << ", Width: " << NewMonitor->Width << ", Height: " << NewMonitor->Height << std::endl;
+                << NewMonitor->Y << ", Width: " << NewMonitor->Width << ", Height: " << NewMonitor->Height << ", Refresh Rate: " << NewMonitor->RefreshRate << std::endl;
 
-                free(CRTCReply);
                 AssignFreeWorkspaceToMonitor(NewMonitor);
             }
         } else {
             std::cerr << "Output: " << Output << " has no crtc, skipping!" << std::endl;
         }
-
-        free(InformationReply);
     }
-
-    free(ResourcesReply);
 }
 
-void RunEventLoop() {
-    std::cout << "Running the event loop" << std::endl;
+/* Names for the spans of event dispatch */
+const char* GetEventName(uint8_t ResponseType) {
+    switch (ResponseType) {
+        case 0: { return "XError"; }
+        case XCB_MAP_REQUEST: { return "MapRequest"; }
+        case XCB_CONFIGURE_REQUEST: { return "ConfigureRequest"; }
+        case XCB_KEY_PRESS: { return "KeyPress"; }
+        case XCB_BUTTON_PRESS: { return "ButtonPress"; }
+        case XCB_UNMAP_NOTIFY: { return "UnmapNotify"; }
+        case XCB_DESTROY_NOTIFY: { return "DestroyNotify"; }
+        case XCB_ENTER_NOTIFY: { return "EnterNotify"; }
+        case XCB_CLIENT_MESSAGE: { return "ClientMessage"; }
+        case XCB_MOTION_NOTIFY: { return "MotionNotify"; }
+        case XCB_PROPERTY_NOTIFY: { return "PropertyNotify"; }
+        default: { return (SyncEventBase != 0 && ResponseType == SyncEventBase + XCB_SYNC_ALARM_NOTIFY) ? "SyncAlarmNotify" : "OtherEvent"; }
+    }
+}
 
+/* Handles every queued event, sends out what they changed, then waits up to Timeout milliseconds (-1 for ever) for something else to do */
+void RunEventLoopIteration(int Timeout) {
+    static std::vector<pollfd> Descriptors; // Kept between iterations, so waiting doesn't allocate
     while (true) {
-        xcb_generic_event_t* NextEvent = xcb_wait_for_event(WM.Connection);
+        XcbPointer<xcb_generic_event_t> OwnedEvent(xcb_poll_for_event(WM.Connection));
+        if (OwnedEvent == nullptr) { break; }
+        xcb_generic_event_t* NextEvent = OwnedEvent.get();
         // std::cout << "Recieved Event: " << (int)NextEvent->response_type << std::endl;
+        TraceScope Scope(GetEventName(NextEvent->response_type & ~0x80), "event");
+        if (NextEvent->response_type != 0) { PruneErrorHandlers(NextEvent->full_sequence); }
+        if (SyncEventBase != 0 && (NextEvent->response_type & ~0x80) == SyncEventBase + XCB_SYNC_ALARM_NOTIFY) { OnSyncAlarmNotify(NextEvent); continue; } // Extension events aren't known until runtime
         switch (NextEvent->response_type & ~0x80) {
+            case 0: { OnXError(NextEvent); break; }
             case XCB_MAP_REQUEST: { OnMapRequest(NextEvent); break; }
+            case XCB_CONFIGURE_REQUEST: { OnConfigureRequest(NextEvent); break; }
             case XCB_KEY_PRESS: { OnBind(NextEvent, Runtime.Keybinds, XCB_KEY_PRESS); break; }
             case XCB_BUTTON_PRESS: { OnBind(NextEvent, Runtime.Mousebinds, XCB_BUTTON_PRESS); break; }
             //case XCB_BUTTON_RELEASE: { OnBind(NextEvent, Runtime.Mousebinds, XCB_BUTTON_RELEASE); break; }
@@ -1036,12 +3885,337 @@ void RunEventLoop() {
             case XCB_ENTER_NOTIFY: { OnEnterNotify(NextEvent); break; }
             case XCB_CLIENT_MESSAGE: { HandleFullScreenRequest(NextEvent); break; }
             case XCB_MOTION_NOTIFY: { OnMotionNotify(NextEvent); break; }
+            case XCB_PROPERTY_NOTIFY: { OnPropertyNotify(NextEvent); break; }
             // default: { std::cout << "Ignored Event: " << (int)NextEvent->response_type << std::endl; break; }
         }
     }
+
+    if (xcb_connection_has_error(WM.Connection)) {
+        std::cerr << "The XCB connection was closed! [EXIT]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // Everything the events changed goes out together, paced to the refresh rate of each monitor
+    PublishEWMH();
+    PublishSubscriptions();
+    PublishStateSnapshot();
+    CommitPendingGeometry();
+    FlushConnection();
+
+    // Subscribers are only polled for writing while they have messages waiting
+    Descriptors = {{xcb_get_file_descriptor(WM.Connection), POLLIN, 0}, {CommitTimer, POLLIN, 0}, {SubscriptionSocket, POLLIN, 0}, {Worker.ResultsReady, POLLIN, 0}, {ChildSignals, POLLIN, 0}};
+    for (auto &Target: Subscribers) { Descriptors.push_back({Target->Socket, static_cast<short>(POLLIN | (Target->Queue.empty() ? 0 : POLLOUT)), 0}); }
+    if (poll(Descriptors.data(), Descriptors.size(), Timeout) < 0 && errno != EINTR) {
+        std::cerr << "Failed to poll the event loop descriptors! [EXIT]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (Descriptors[1].revents & POLLIN) {
+        uint64_t Expirations;
+        read(CommitTimer, &Expirations, sizeof(Expirations));
+    }
+    if (Descriptors[3].revents & POLLIN) { OnPropertyResults(); } // Windows waiting on their properties are mapped before the next events
+    if (Descriptors[4].revents & POLLIN) { OnChildSignals(); }
+    for (size_t i = 5; i < Descriptors.size(); i++) {
+        std::shared_ptr<Subscriber> Target = Subscribers[i - 5];
+        if (Descriptors[i].revents & (POLLIN | POLLHUP | POLLERR)) { ReadSubscriber(*Target); }
+        if (Descriptors[i].revents & POLLOUT) { FlushSubscriber(*Target); }
+    }
+    RemoveGoneSubscribers();
+    if (Descriptors[2].revents & POLLIN) { AcceptSubscribers(); }
+}
+
+void RunEventLoop() {
+    std::cout << "Running the event loop" << std::endl;
+    while (true) { RunEventLoopIteration(-1); }
+}
+
+// ! STRESS
+/* Runs random tree operations on a workspace that isn't connected to the X server, checking the tree after every one of them. These are the tree routines
+the commands and the map / unmap paths are built on, so a broken invariant shows up here with its seed instead of taking down a desktop. Prints the time per operation */
+int RunTreeStress(unsigned int Seed, long Operations) {
+    enum StressOperation { INSERT, INSERT_SHALLOWEST, REMOVE, SWAP_SIDES, FLIP_SPLIT, RESIZE, TOGGLE_FLOATING, REBALANCE, FOCUS, MOVE_ACROSS, OPERATION_COUNT };
+    const char* Names[] = {"Insert", "InsertShallowest", "Remove", "SwapSides", "FlipSplit", "Resize", "ToggleFloating", "Rebalance", "Focus", "MoveAcross"};
+    const int MaximumWindows = 64; // Inserts get rarer as the workspace fills up, so the tree size wanders instead of only growing
+    uint64_t Nanoseconds[OPERATION_COUNT] = {};
+    long Counts[OPERATION_COUNT] = {};
+
+    std::mt19937 Random(Seed);
+    std::shared_ptr<Workspace> TargetWorkspace = std::make_shared<Workspace>();
+    std::shared_ptr<Workspace> NeighbourWorkspace = std::make_shared<Workspace>(); // Shown on a neighbouring monitor, windows only get there through MoveAcross
+    LayoutRect Area = {0, 0, 1920, 1080};
+    xcb_window_t NextWindow = 1;
+    long ManagedWindows = 0; // Across both workspaces, so a window that falls out of every tree is caught
+    std::cout << "Stressing the container tree with seed " << Seed << " for " << Operations << " operations" << std::endl;
+    std::cout.setstate(std::ios::failbit); // The tree routines log every step
+    std::cerr.setstate(std::ios::failbit); // Including the moves they refuse
+
+    for (long i = 0; i < Operations; i++) {
+        std::vector<std::shared_ptr<Container>> Tiled = GetTiledContainersInOrder(TargetWorkspace->RootContainer);
+        int Windows = Tiled.size() + TargetWorkspace->FloatingContainers.size();
+        StressOperation Operation = static_cast<StressOperation>(Random() % OPERATION_COUNT);
+        if ((Operation == INSERT || Operation == INSERT_SHALLOWEST) && static_cast<int>(Random() % MaximumWindows) < Windows) { Operation = REMOVE; }
+        if (Operation != INSERT && Operation != INSERT_SHALLOWEST && Windows == 0) { Operation = INSERT; }
+        std::shared_ptr<Container> Target = Tiled.empty() ? nullptr : Tiled[Random() % Tiled.size()];
+        WindowSegment Section = static_cast<WindowSegment>(Random() % 4);
+
+        uint64_t Start = GetMonotonicTime();
+        switch (Operation) {
+            case INSERT:
+            case INSERT_SHALLOWEST: {
+                std::shared_ptr<Container> NewContainer = std::make_shared<Container>();
+                NewContainer->Direction = NONE;
+                NewContainer->Value = std::make_shared<Window>();
+                NewContainer->Value->Window = NextWindow++;
+                if (TargetWorkspace->RootContainer == nullptr) {
+                    TargetWorkspace->RootContainer = NewContainer;
+                } else if (Operation == INSERT_SHALLOWEST) {
+                    InsertContainerBeside(GetShallowestContainer(TargetWorkspace->RootContainer), NewContainer, Section, TargetWorkspace);
+                } else {
+                    InsertContainerBeside(Target, NewContainer, Section, TargetWorkspace);
+                }
+                LinkFocusHistory(NewContainer, TargetWorkspace, Random() % 2 == 0);
+                ManagedWindows++;
+                break;
+            }
+            case REMOVE: {
+                if (Target != nullptr) {
+                    UnlinkFocusHistory(Target, TargetWorkspace);
+                    DetachContainerFromTree(Target, TargetWorkspace);
+                } else {
+                    UnlinkFocusHistory(TargetWorkspace->FloatingContainers.back(), TargetWorkspace);
+                    TargetWorkspace->FloatingContainers.pop_back();
+                }
+                ManagedWindows--;
+                break;
+            }
+            case SWAP_SIDES: { if (Target != nullptr && Target->Parent != nullptr) { SwapContainerChildren(Target->Parent); } break; }
+            case FLIP_SPLIT: { if (Target != nullptr && Target->Parent != nullptr) { FlipContainerSplit(Target->Parent); } break; }
+            case RESIZE: { if (Target != nullptr) { ResizeContainerInDirection(Target, Section); } break; }
+            case TOGGLE_FLOATING: {
+                if (Target != nullptr && (Random() % 2 == 0 || TargetWorkspace->FloatingContainers.empty())) { // Tiled to floating
+                    DetachContainerFromTree(Target, TargetWorkspace);
+                    Target->Value->Floating = true;
+                    TargetWorkspace->FloatingContainers.push_back(Target);
+                } else if (!TargetWorkspace->FloatingContainers.empty()) { // Floating to tiled
+                    std::shared_ptr<Container> Floater = TargetWorkspace->FloatingContainers.back();
+                    TargetWorkspace->FloatingContainers.pop_back();
+                    Floater->Value->Floating = false;
+                    if (Target == nullptr) { TargetWorkspace->RootContainer = Floater; } else { InsertContainerBeside(Target, Floater, Section, TargetWorkspace); }
+                }
+                break;
+            }
+            case REBALANCE: { RebalanceTree(TargetWorkspace, Area); break; }
+            case FOCUS: {
+                if (Target != nullptr) { LinkFocusHistory(Target, TargetWorkspace, true); } else { LinkFocusHistory(TargetWorkspace->FloatingContainers[Random() % TargetWorkspace->FloatingContainers.size()], TargetWorkspace, true); }
+                break;
+            }
+            case MOVE_ACROSS: {
+                // The neighbour sometimes has a fullscreened window, and then nothing in its spatial index for a move to enter by
+                std::vector<std::shared_ptr<Container>> NeighbourTiled = GetTiledContainersInOrder(NeighbourWorkspace->RootContainer);
+                NeighbourWorkspace->FullscreenContainer = (!NeighbourTiled.empty() && Random() % 4 == 0) ? NeighbourTiled[Random() % NeighbourTiled.size()] : nullptr;
+                bool Outward = (NeighbourTiled.empty() || Random() % 2 == 0);
+                std::vector<std::shared_ptr<Container>> &FromTiled = Outward ? Tiled : NeighbourTiled;
+                std::vector<std::shared_ptr<Container>> &ToTiled = Outward ? NeighbourTiled : Tiled;
+                std::shared_ptr<Workspace> From = Outward ? TargetWorkspace : NeighbourWorkspace;
+                std::shared_ptr<Workspace> To = Outward ? NeighbourWorkspace : TargetWorkspace;
+                if (FromTiled.empty()) { break; }
+                std::shared_ptr<Container> Entry = (!ToTiled.empty() && To->FullscreenContainer == nullptr && Random() % 2 == 0) ? ToTiled[Random() % ToTiled.size()] : nullptr;
+                std::shared_ptr<Container> PromotionContainer = nullptr;
+                MoveContainerBetweenTrees(FromTiled[Random() % FromTiled.size()], From, To, Entry, Section, PromotionContainer);
+                break;
+            }
+            case OPERATION_COUNT: { break; }
+        }
+        Nanoseconds[Operation] += GetMonotonicTime() - Start;
+        Counts[Operation]++;
+
+        std::string Problem;
+        long Found = 0;
+        for (auto &Checked: {TargetWorkspace, NeighbourWorkspace}) { Found += GetTiledContainersInOrder(Checked->RootContainer).size() + Checked->FloatingContainers.size(); }
+        if (IsWorkspaceTreeValid(TargetWorkspace, Problem) && IsWorkspaceTreeValid(NeighbourWorkspace, Problem) && Found != ManagedWindows) { Problem = "a window fell out of every tree"; }
+        if (!Problem.empty()) {
+            std::cout.clear();
+            std::cerr.clear();
+            std::cerr << "Tree broke after operation " << i << " (" << Names[Operation] << ") with seed " << Seed << ": " << Problem << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout.clear();
+    std::cerr.clear();
+    std::cout << "Tree stayed valid for " << Operations << " operations" << std::endl;
+    for (int i = 0; i < OPERATION_COUNT; i++) {
+        if (Counts[i] == 0) { continue; }
+        std::cout << "    " << Names[i] << ": " << Counts[i] << " ops, " << (Nanoseconds[i] / Counts[i]) << " ns/op" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Hammers the snapshot's sequence lock with a writer thread and readers that check every snapshot they get is one the writer wrote whole.
+Each state is derived from one number, so a torn read shows up as fields that disagree. Runs in private memory, nothing is shared with a running WM */
+int RunSnapshotStress(long Writes) {
+    auto Segment = std::make_unique<SnapshotSegment>();
+    auto MakeState = [](uint32_t Value) {
+        SnapshotState State = {};
+        State.MonitorCount = Value % SNAPSHOT_MONITORS;
+        State.WorkspaceCount = Value % SNAPSHOT_WORKSPACES;
+        State.FocusedWindow = Value;
+        State.FocusedWorkspace = Value;
+        for (int i = 0; i < SNAPSHOT_MONITORS; i++) { State.Monitors[i].X = Value + i; }
+        for (int i = 0; i < SNAPSHOT_WORKSPACES; i++) { State.Workspaces[i].Windows = Value + i; }
+        return State;
+    };
+
+    WriteStateSnapshot(Segment.get(), MakeState(0)); // So even the first read has a state to check against
+    std::atomic<bool> Done{false};
+    std::thread Writer([&]() {
+        for (long i = 1; i <= Writes; i++) { WriteStateSnapshot(Segment.get(), MakeState(i)); }
+        Done = true;
+    });
+
+    const int ReaderCount = 3;
+    std::atomic<uint64_t> Reads{0}, Retries{0}, Torn{0};
+    std::vector<std::thread> Readers;
+    for (int i = 0; i < ReaderCount; i++) {
+        Readers.emplace_back([&]() {
+            SnapshotState State;
+            uint64_t ReaderRetries = 0;
+            while (!Done) {
+                if (!ReadStateSnapshot(Segment.get(), State, &ReaderRetries)) { continue; }
+                Reads++;
+                SnapshotState Expected = MakeState(State.FocusedWindow);
+                if (memcmp(&State, &Expected, sizeof(SnapshotState)) != 0) { Torn++; }
+            }
+            Retries += ReaderRetries;
+        });
+    }
+    Writer.join();
+    for (auto &Reader: Readers) { Reader.join(); }
+
+    std::cout << "Snapshot stress: " << Writes << " writes, " << Reads << " reads by " << ReaderCount << " readers, " << Retries << " retries, " << Torn << " torn" << std::endl;
+    if (Torn > 0 || Segment->Sequence.load() != static_cast<uint64_t>(Writes + 1) * 2) {
+        std::cerr << "The snapshot's sequence lock let a torn read through" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// ! SOAK
+/* Resident set size of the process in bytes */
+uint64_t GetResidentMemory() {
+    std::ifstream Statm("/proc/self/statm");
+    uint64_t Pages = 0;
+    uint64_t Resident = 0;
+    Statm >> Pages >> Resident;
+    return Resident * sysconf(_SC_PAGESIZE);
+}
+
+/* Drives the running WM the way weeks of use would, from a client connection of its own. Windows are mapped, floated, dragged, moved between workspaces and closed
+over and over while the workspaces are switched, and resident memory has to stay flat once the caches have warmed up. Meant for a throwaway server, eg. Xvfb */
+int RunSoak(long Cycles) {
+    const int WindowsPerCycle = 4;
+    const uint64_t AllowedGrowth = 2 * 1024 * 1024; // Bytes of allocator slack, a leak in any of the paths passes this long before the end
+    std::unique_ptr<xcb_connection_t, decltype(&xcb_disconnect)> Client(xcb_connect(nullptr, nullptr), xcb_disconnect); // Disconnected on every way out, even a connection that failed has to be
+    if (xcb_connection_has_error(Client.get())) {
+        std::cerr << "Failed to open the soak client's connection" << std::endl;
+        return EXIT_FAILURE;
+    }
+    xcb_screen_t* ClientScreen = xcb_setup_roots_iterator(xcb_get_setup(Client.get())).data;
+    std::mt19937 Random(Cycles);
+    long Warmup = std::min(Cycles - 1, std::max(100L, Cycles / 10));
+    uint64_t Baseline = 0;
+    std::cout << "Soaking the WM for " << Cycles << " cycles" << std::endl;
+    std::cout.setstate(std::ios::failbit); // The WM logs every step
+
+    // Runs the event loop until the WM has caught up with the client, or clearly won't
+    auto RunUntil = [](std::function<bool()> Done) {
+        for (int i = 0; i < 1000 && !Done(); i++) { RunEventLoopIteration(1); }
+        return Done();
+    };
+    auto IsManaged = [](xcb_window_t Window) { return GetWorkspaceAndContainerFromWindow_PossibleNullptr(Window) != nullptr; };
+
+    for (long Cycle = 0; Cycle < Cycles; Cycle++) {
+        std::vector<xcb_window_t> Windows;
+        for (int i = 0; i < WindowsPerCycle; i++) {
+            xcb_window_t NewWindow = xcb_generate_id(Client.get());
+            xcb_create_window(Client.get(), XCB_COPY_FROM_PARENT, NewWindow, ClientScreen->root, 0, 0, 100, 100, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, ClientScreen->root_visual, 0, nullptr);
+            xcb_map_window(Client.get(), NewWindow);
+            Windows.push_back(NewWindow);
+        }
+        xcb_flush(Client.get());
+        if (!RunUntil([&]() { return std::all_of(Windows.begin(), Windows.end(), IsManaged); })) {
+            std::cout.clear();
+            std::cerr << "The WM didn't map the soak windows of cycle " << Cycle << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // Float the first window, then drag and resize it the way the mousebinds do, with the pointer's motion fed through OnMotionNotify
+        FocusContainer(GetWorkspaceAndContainerFromWindow_PossibleNullptr(Windows[0])->Container);
+        InternalCommand["ToggleActiveWindowFloating"]("", 0);
+        RunUntil([&]() { return IsManaged(Windows[0]) && GetWorkspaceAndContainerFromWindow_PossibleNullptr(Windows[0])->Container->Value->Floating; });
+        for (const char* Command: {"DragFloatingWindow", "ResizeFloatingWindow"}) {
+            if (!IsManaged(Windows[0])) { break; }
+            FocusContainer(GetWorkspaceAndContainerFromWindow_PossibleNullptr(Windows[0])->Container);
+            InternalCommand[Command]("", 0); // Starts the drag at the cursor
+            for (int i = 0; i < 8; i++) {
+                xcb_motion_notify_event_t Motion = {};
+                Motion.response_type = XCB_MOTION_NOTIFY;
+                Motion.detail = XCB_MOTION_NORMAL;
+                Motion.root = ClientScreen->root;
+                Motion.event = ClientScreen->root;
+                Motion.root_x = Random() % ClientScreen->width_in_pixels;
+                Motion.root_y = Random() % ClientScreen->height_in_pixels;
+                xcb_warp_pointer(Client.get(), XCB_NONE, ClientScreen->root, 0, 0, 0, 0, Motion.root_x, Motion.root_y); // So the server agrees with the cursor the WM was told about
+                xcb_flush(Client.get());
+                OnMotionNotify(reinterpret_cast<xcb_generic_event_t*>(&Motion));
+                RunEventLoopIteration(0);
+            }
+            InternalCommand[Command]("", 0); // Drops it, like releasing the button
+        }
+
+        // Send a window to another workspace, then switch there and back
+        if (IsManaged(Windows[1])) {
+            FocusContainer(GetWorkspaceAndContainerFromWindow_PossibleNullptr(Windows[1])->Container);
+            InternalCommand["MoveActiveWindowToWorkspace"]("1", 0);
+        }
+        InternalCommand["SetFocusedMonitorToWorkspace"]("1", 0);
+        RunEventLoopIteration(0);
+        InternalCommand["SetFocusedMonitorToWorkspace"]("0", 0);
+
+        // Close them the two ways clients do, withdrawn and then destroyed or just destroyed
+        for (size_t i = 0; i < Windows.size(); i++) {
+            if (i % 2 == 0) { xcb_unmap_window(Client.get(), Windows[i]); }
+            xcb_destroy_window(Client.get(), Windows[i]);
+        }
+        xcb_flush(Client.get());
+        if (!RunUntil([&]() { return std::none_of(Windows.begin(), Windows.end(), IsManaged); })) {
+            std::cout.clear();
+            std::cerr << "The WM didn't let go of the soak windows of cycle " << Cycle << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (Cycle == Warmup) { Baseline = GetResidentMemory(); }
+        if (Cycle > Warmup && (Cycle % 1000 == 0 || Cycle == Cycles - 1) && GetResidentMemory() > Baseline + AllowedGrowth) {
+            std::cout.clear();
+            std::cerr << "Resident memory grew from " << Baseline / 1024 << " KiB to " << GetResidentMemory() / 1024 << " KiB by cycle " << Cycle << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout.clear();
+    std::cout << "Resident memory stayed flat for " << Cycles << " cycles: " << Baseline / 1024 << " KiB after warming up, " << GetResidentMemory() / 1024 << " KiB at the end" << std::endl;
+    return EXIT_SUCCESS;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--stress-tree") { // exert --stress-tree [Seed] [Operations]
+        unsigned int Seed = (argc > 2) ? std::stoul(argv[2]) : std::random_device()();
+        long Operations = (argc > 3) ? std::stol(argv[3]) : 1000000;
+        return RunTreeStress(Seed, Operations);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--stress-snapshot") { return RunSnapshotStress((argc > 2) ? std::stol(argv[2]) : 10000000); } // exert --stress-snapshot [Writes]
+    bool Soak = (argc > 1 && std::string(argv[1]) == "--soak"); // exert --soak [Cycles], runs the WM and drives it from inside
+
     for (auto Pair: Runtime.Exports) {
         setenv(Pair.first.c_str(), Pair.second.c_str(), 1);
     }
@@ -1084,8 +4258,11 @@ int main() {
     }
     InitialiseMonitors();
 
+    InitialiseSubscriptions(); // Before anything is started, so it inherits $EXERT_SOCKET
     for (auto Command: Runtime.StartupCommands) {
+        if (Soak) { break; } // Nothing but the soak's own windows
         if (fork() == 0) {
+            UnblockChildSignals();
             std::cout << "Executing: " << Command << std::endl;
             execl("/bin/sh", "/bin/sh", "-c", Command.c_str(), (void *)NULL);
         }
@@ -1096,12 +4273,46 @@ int main() {
     WM.ProtocolsContainer.DeleteWindow = GetAtom("WM_DELETE_WINDOW");
     WM.ProtocolsContainer.NetWmState = GetAtom("_NET_WM_STATE");
     WM.ProtocolsContainer.NetWmStateFullscreen = GetAtom("_NET_WM_STATE_FULLSCREEN");
+    WM.ProtocolsContainer.NetWmStateHidden = GetAtom("_NET_WM_STATE_HIDDEN");
     WM.ProtocolsContainer.NetWmWindowTypeDialog = GetAtom("_NET_WM_WINDOW_TYPE_DIALOG");
     WM.ProtocolsContainer.NetWmWindowTypeUtility = GetAtom("_NET_WM_WINDOW_TYPE_UTILITY");
     WM.ProtocolsContainer.NetWmWindowTypeSplash = GetAtom("_NET_WM_WINDOW_TYPE_SPLASH");
     WM.ProtocolsContainer.NetWmWindowType = GetAtom("_NET_WM_WINDOW_TYPE");
+    WM.ProtocolsContainer.NetWmBypassCompositor = GetAtom("_NET_WM_BYPASS_COMPOSITOR");
+    WM.ProtocolsContainer.NetWmSyncRequest = GetAtom("_NET_WM_SYNC_REQUEST");
+    WM.ProtocolsContainer.NetWmSyncRequestCounter = GetAtom("_NET_WM_SYNC_REQUEST_COUNTER");
+    WM.ProtocolsContainer.NetWmPid = GetAtom("_NET_WM_PID");
+    WM.ProtocolsContainer.Floating = GetAtom("FLOATING");
+    WM.ProtocolsContainer.NetSupported = GetAtom("_NET_SUPPORTED");
+    WM.ProtocolsContainer.NetSupportingWmCheck = GetAtom("_NET_SUPPORTING_WM_CHECK");
+    WM.ProtocolsContainer.NetWmName = GetAtom("_NET_WM_NAME");
+    WM.ProtocolsContainer.Utf8String = GetAtom("UTF8_STRING");
+    WM.ProtocolsContainer.NetClientList = GetAtom("_NET_CLIENT_LIST");
+    WM.ProtocolsContainer.NetActiveWindow = GetAtom("_NET_ACTIVE_WINDOW");
+    WM.ProtocolsContainer.NetNumberOfDesktops = GetAtom("_NET_NUMBER_OF_DESKTOPS");
+    WM.ProtocolsContainer.NetDesktopNames = GetAtom("_NET_DESKTOP_NAMES");
+    WM.ProtocolsContainer.NetCurrentDesktop = GetAtom("_NET_CURRENT_DESKTOP");
+    WM.ProtocolsContainer.ExertCurrentDesktops = GetAtom("_EXERT_CURRENT_DESKTOPS");
+
+    CommitTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (CommitTimer < 0) {
+        std::cerr << "Failed to create the commit timer!" << std::endl;
+        return EXIT_FAILURE;
+    }
 
+    if (Runtime.Settings.TraceEvents > 0) {
+        Trace.Events = std::vector<TraceEvent>(Runtime.Settings.TraceEvents); // Atomics can't be moved, so the buffer is built at its final size
+        std::cout << "Tracing the last " << Runtime.Settings.TraceEvents << " spans" << std::endl;
+    }
+    CompileWindowRules();
+    InitialiseSync();
+    InitialiseChildSignals(); // Before the property worker's thread
+    InitialisePropertyWorker();
+    InitialiseThrottleCGroup();
+    InitialiseStateSnapshot();
     StartupWM();
+    if (Soak) { return RunSoak((argc > 2) ? std::stol(argv[2]) : 250000); }
+    ReplenishWarmPool();
     RunEventLoop();
     return EXIT_SUCCESS;
 }
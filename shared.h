@@ -4,6 +4,7 @@
 #include <xcb/xproto.h>
 #include <unordered_set>
 #include <map>
+#include <vector>
 #include <X11/keysym.h>
 
 #define MOUSE_LEFT_CLICK 1
@@ -26,6 +27,31 @@ struct WMSettings {
     int32_t InActiveTiledWindowBorderColour = -1;
     int32_t ActiveFloatingWindowBorderColour = -1;
     int32_t InActiveFloatingWindowBorderColour = -1;
+    int AnimationFrames = 0; // Number of monitor frames to interpolate window geometry changes over, 0 or 1 disables animations
+    std::string DefaultLayout = "Tree"; // Layout new workspaces start with, one of Tree, Balanced, Grid or MasterStack
+    int TraceEvents = 0; // Spans of WM work kept in memory for the DumpTrace command, 0 disables tracing
+
+    // What happens to the processes of windows on workspaces that no monitor shows, workspaces start with this and SetThrottle changes it
+    std::string BackgroundThrottle = "None"; // "None", "Stop" to SIGSTOP them until they're shown, or "CGroup" to move them into ThrottleCGroup
+    std::string ThrottleCGroup = ""; // cgroup v2 directory for "CGroup", created if it doesn't exist. It needs a common ancestor with the clients that we can write to
+    std::string ThrottleCpuMax = "10000 100000"; // Written to the cgroup's cpu.max, quota and period in microseconds
+    std::unordered_set<std::string> ThrottleExempt; // WM_CLASS classes or instances that always keep running, eg. audio players
+
+    std::map<std::string, int> WarmPool; // Keybind commands to keep this many instances of launched offscreen, so the keybind only has to show one. The client has to set _NET_WM_PID
+    std::string StateSnapshot = ""; // Name of a shared memory object, eg. "/exert-state" for /dev/shm/exert-state, that status bars can map to read the WM state without asking for it. Empty disables it
+};
+
+/* Placement for windows as they're first mapped. A rule applies if every match field that isn't empty matches, later rules override earlier ones */
+struct WindowRule {
+    std::string Class; // Class half of WM_CLASS, eg. "firefox"
+    std::string Instance; // Instance half of WM_CLASS
+    std::string Title; // _NET_WM_NAME, or WM_NAME if the window doesn't set it, must match exactly
+    std::string WindowType; // An atom from _NET_WM_WINDOW_TYPE, eg. "_NET_WM_WINDOW_TYPE_DIALOG"
+
+    int Workspace = -1; // Workspace to put the window on, -1 to use the active one
+    int Floating = -1; // 1 to float the window, 0 to tile it, -1 to decide as usual
+    float Width = 0; // Size of the window if it's floating, as a scale of 0 to 1 of the monitor, 0 to keep the default
+    float Height = 0;
 };
 
 /* Stuff we configure */
@@ -36,5 +62,6 @@ struct Runtime {
     std::unordered_set<std::string> Monitors; // Settings for monitors
     std::multimap<std::string, std::string> Exports; // Environment Variables
     std::unordered_set<std::string> StartupCommands; // Commands to run at boot
+    std::vector<WindowRule> Rules; // Applied in order to every window as it's first mapped
 };
 